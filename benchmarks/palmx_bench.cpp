@@ -0,0 +1,405 @@
+/*******************************************************************************************
+*
+*   palmx benchmark - scene throughput
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+********************************************************************************************/
+
+
+
+// Renders scripted, deterministic scenes along a fixed camera path for a fixed number of frames
+// and prints frame time percentiles and render statistics as JSON.
+//
+// Usage: palmx_bench [--frames N] [--warmup N] [--scene cubes|cubes_instanced|models|hud|sprites|all] [--output file] [--windowed] [--render-thread]
+//
+// Runs headless by default, so it works on display-less CI machines with Mesa's llvmpipe.
+
+#include <palmx.h>
+#include <palmx_math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace palmx;
+
+struct BenchScene
+{
+	std::string name;
+	uint32_t object_count;
+	std::function<void()> load;
+	std::function<void(uint32_t frame)> draw;
+	std::function<void()> unload;
+};
+
+struct BenchResult
+{
+	std::string name;
+	uint32_t object_count;
+	std::vector<double> frame_ms;
+	double draw_calls{ 0 };
+	double objects_drawn{ 0 };
+	double gpu_ms[gpu_pass::Count]{};
+};
+
+// Small LCG, so every run places objects at the same positions on every platform
+struct Random
+{
+	uint32_t state;
+
+	float Next()
+	{
+		state = state * 1664525u + 1013904223u;
+		return static_cast<float>(state >> 8) / static_cast<float>(1u << 24);
+	}
+
+	float Range(float min, float max)
+	{
+		return min + (max - min) * Next();
+	}
+};
+
+// The camera orbits the origin once per 600 frames, always looking at the center
+static Camera GetCamera(uint32_t frame, float radius, float height)
+{
+	float angle = glm::radians(static_cast<float>(frame) / 600.0f * 360.0f);
+
+	Camera camera;
+	camera.transform.position = glm::vec3(std::cos(angle) * radius, height, std::sin(angle) * radius);
+	camera.transform.rotation.x = glm::degrees(std::atan2(-height, radius));
+	camera.transform.rotation.y = glm::degrees(std::atan2(-camera.transform.position.z, -camera.transform.position.x));
+	return camera;
+}
+
+static double Percentile(const std::vector<double>& sorted, double percentile)
+{
+	if (sorted.empty())
+		return 0.0;
+
+	// Nearest rank
+	size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static BenchResult RunScene(BenchScene& scene, uint32_t warmup_frames, uint32_t frames)
+{
+	BenchResult result;
+	result.name = scene.name;
+	result.object_count = scene.object_count;
+	result.frame_ms.reserve(frames);
+
+	scene.load();
+
+	auto last_frame_end = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < warmup_frames + frames; frame++)
+	{
+		Camera camera = GetCamera(frame, 30.0f, 12.0f);
+
+		BeginDrawing(camera);
+		scene.draw(frame);
+		EndDrawing();
+
+		// Frame to frame time, so work the GPU driver defers to the next frame is still counted
+		auto frame_end = std::chrono::steady_clock::now();
+		double frame_ms = std::chrono::duration<double, std::milli>(frame_end - last_frame_end).count();
+		last_frame_end = frame_end;
+
+		if (frame < warmup_frames)
+			continue;
+
+		RenderStats stats = GetRenderStats();
+		result.frame_ms.push_back(frame_ms);
+		result.draw_calls += stats.draw_calls;
+		result.objects_drawn += stats.objects_drawn;
+	}
+
+	result.draw_calls /= frames;
+	result.objects_drawn /= frames;
+
+	// GPU results arrive a few frames late, the history still belongs to this scene's last frames
+	std::vector<GpuFrameTimings> gpu_timings = GetGpuTimings(frames);
+	for (const GpuFrameTimings& timings : gpu_timings)
+	{
+		for (int pass = 0; pass < gpu_pass::Count; pass++)
+			result.gpu_ms[pass] += timings.pass_ms[pass] / gpu_timings.size();
+	}
+
+	scene.unload();
+
+	return result;
+}
+
+static std::vector<BenchScene> CreateScenes()
+{
+	std::vector<BenchScene> scenes;
+
+	// Individually drawn copies of one cube on a grid, they share a vertex array and batch by sort key
+	static Primitive grid_cube;
+	static std::vector<Primitive> cubes;
+	scenes.push_back({ "cubes", 2500,
+		[]() {
+			grid_cube = CreateCube();
+			for (int i = 0; i < 2500; i++)
+			{
+				Primitive cube = grid_cube;
+				cube.transform.position = glm::vec3((i % 50) - 25.0f, 0.0f, (i / 50) - 25.0f);
+				cube.transform.scale = glm::vec3(0.4f);
+				cube.color = { (i % 7) / 7.0f, (i % 5) / 5.0f, (i % 3) / 3.0f, 1.0f };
+				cubes.push_back(cube);
+			}
+		},
+		[](uint32_t frame) {
+			for (Primitive& cube : cubes)
+			{
+				cube.transform.rotation.y = static_cast<float>(frame);
+				DrawPrimitive(cube);
+			}
+		},
+		[]() {
+			cubes.clear();
+			UnloadPrimitive(grid_cube);
+		}
+	});
+
+	// The same grid through a single instanced draw
+	static Primitive instanced_cube;
+	static std::vector<Transform> cube_transforms;
+	scenes.push_back({ "cubes_instanced", 2500,
+		[]() {
+			instanced_cube = CreateCube();
+			for (int i = 0; i < 2500; i++)
+			{
+				Transform transform;
+				transform.position = glm::vec3((i % 50) - 25.0f, 0.0f, (i / 50) - 25.0f);
+				transform.scale = glm::vec3(0.4f);
+				cube_transforms.push_back(transform);
+			}
+		},
+		[](uint32_t frame) {
+			for (Transform& transform : cube_transforms)
+				transform.rotation.y = static_cast<float>(frame);
+			DrawPrimitiveInstanced(instanced_cube, cube_transforms);
+		},
+		[]() {
+			cube_transforms.clear();
+			UnloadPrimitive(instanced_cube);
+		}
+	});
+
+	// Copies of a textured model, all sharing the cached meshes
+	static std::vector<Model> models;
+	scenes.push_back({ "models", 200,
+		[]() {
+			Random random{ 1 };
+			for (int i = 0; i < 200; i++)
+			{
+				Model model = LoadModel(GetResourceDir() + "/fps/models/target_dummy.obj");
+				model.transform.position = glm::vec3(random.Range(-20.0f, 20.0f), 0.0f, random.Range(-20.0f, 20.0f));
+				model.transform.rotation.y = random.Range(0.0f, 360.0f);
+				models.push_back(model);
+			}
+		},
+		[](uint32_t frame) {
+			for (Model& model : models)
+				DrawModel(model);
+		},
+		[]() {
+			for (const Model& model : models)
+				UnloadModel(model);
+			models.clear();
+		}
+	});
+
+	// A text heavy HUD, every line changes every frame
+	scenes.push_back({ "hud", 120,
+		[]() {},
+		[](uint32_t frame) {
+			for (int line = 0; line < 120; line++)
+			{
+				std::string text = "Line " + std::to_string(line) + " frame " + std::to_string(frame) + " ammo " + std::to_string((frame + line) % 100);
+				DrawString(text, glm::vec2(10.0f + (line / 40) * 420.0f, 10.0f + (line % 40) * 17.0f), 0.3f, color_white, static_cast<uint8_t>(line % 4));
+			}
+		},
+		[]() {}
+	});
+
+	// Thousands of moving sprites
+	static std::vector<Sprite> sprites;
+	static std::vector<glm::vec2> sprite_velocities;
+	scenes.push_back({ "sprites", 5000,
+		[]() {
+			Random random{ 2 };
+			Texture texture = LoadTexture(GetResourceDir() + "/fps/sprites/bullet.png");
+			for (int i = 0; i < 5000; i++)
+			{
+				Sprite sprite;
+				sprite.texture = texture;
+				sprite.transform.position = glm::vec3(random.Range(0.0f, 1280.0f), random.Range(0.0f, 720.0f), 0.0f);
+				sprite.transform.scale = glm::vec3(random.Range(8.0f, 32.0f));
+				sprite.layer = static_cast<uint8_t>(i % 3);
+				sprites.push_back(sprite);
+				sprite_velocities.push_back(glm::vec2(random.Range(-4.0f, 4.0f), random.Range(-4.0f, 4.0f)));
+			}
+		},
+		[](uint32_t frame) {
+			for (size_t i = 0; i < sprites.size(); i++)
+			{
+				// Positions are a function of the frame, not of the measured time
+				glm::vec2 position = glm::vec2(sprites[i].transform.position.x, sprites[i].transform.position.y) + sprite_velocities[i] * static_cast<float>(frame);
+				Sprite sprite = sprites[i];
+				sprite.transform.position.x = std::fmod(std::fmod(position.x, 1280.0f) + 1280.0f, 1280.0f);
+				sprite.transform.position.y = std::fmod(std::fmod(position.y, 720.0f) + 720.0f, 720.0f);
+				DrawSprite(sprite);
+			}
+		},
+		[]() {
+			UnloadTexture(sprites.front().texture);
+			sprites.clear();
+			sprite_velocities.clear();
+		}
+	});
+
+	return scenes;
+}
+
+static std::string ToJson(const std::vector<BenchResult>& results, uint32_t frames, bool headless, bool render_thread)
+{
+	static const char* pass_names[gpu_pass::Count] = { "scene", "ui", "blit" };
+
+	std::ostringstream json;
+	json << "{\n  \"frames\": " << frames << ",\n  \"headless\": " << (headless ? "true" : "false")
+		<< ",\n  \"render_thread\": " << (render_thread ? "true" : "false") << ",\n  \"scenes\": [";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& result = results[i];
+
+		std::vector<double> sorted = result.frame_ms;
+		std::sort(sorted.begin(), sorted.end());
+
+		double mean = 0.0;
+		for (double frame_ms : sorted)
+			mean += frame_ms / sorted.size();
+
+		json << (i > 0 ? "," : "") << "\n    {\n"
+			<< "      \"name\": \"" << result.name << "\",\n"
+			<< "      \"objects\": " << result.object_count << ",\n"
+			<< "      \"frame_ms\": { \"mean\": " << mean
+			<< ", \"p50\": " << Percentile(sorted, 50.0)
+			<< ", \"p95\": " << Percentile(sorted, 95.0)
+			<< ", \"p99\": " << Percentile(sorted, 99.0)
+			<< ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << " },\n"
+			<< "      \"gpu_ms\": {";
+		for (int pass = 0; pass < gpu_pass::Count; pass++)
+			json << (pass > 0 ? "," : "") << " \"" << pass_names[pass] << "\": " << result.gpu_ms[pass];
+		json << " },\n"
+			<< "      \"draw_calls\": " << result.draw_calls << ",\n"
+			<< "      \"objects_drawn\": " << result.objects_drawn << "\n    }";
+	}
+
+	json << "\n  ]\n}\n";
+	return json.str();
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frames = 600;
+	uint32_t warmup_frames = 60;
+	std::string scene_name = "all";
+	std::string output_path;
+	bool headless = true;
+	bool render_thread = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--frames" && i + 1 < argc)
+			frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (argument == "--warmup" && i + 1 < argc)
+			warmup_frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (argument == "--scene" && i + 1 < argc)
+			scene_name = argv[++i];
+		else if (argument == "--output" && i + 1 < argc)
+			output_path = argv[++i];
+		else if (argument == "--windowed")
+			headless = false;
+		else if (argument == "--render-thread")
+			render_thread = true;
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--frames N] [--warmup N] [--scene cubes|cubes_instanced|models|hud|sprites|all] [--output file] [--windowed] [--render-thread]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (frames == 0)
+	{
+		std::cerr << "At least one measured frame is required" << std::endl;
+		return 1;
+	}
+
+	InitFlags flags = init_flag::None;
+	if (headless)
+		flags |= init_flag::Headless;
+	if (render_thread)
+		flags |= init_flag::RenderThread;
+
+	Init("palmx bench", 1280, 720, flags);
+
+	std::vector<BenchScene> scenes = CreateScenes();
+	std::vector<BenchResult> results;
+	for (BenchScene& scene : scenes)
+	{
+		if (scene_name == "all" || scene_name == scene.name)
+			results.push_back(RunScene(scene, warmup_frames, frames));
+	}
+
+	Exit();
+
+	if (results.empty())
+	{
+		std::cerr << "Unknown scene " << scene_name << std::endl;
+		return 1;
+	}
+
+	std::string json = ToJson(results, frames, headless, render_thread);
+	if (output_path.empty())
+	{
+		std::cout << json;
+	}
+	else
+	{
+		std::ofstream file(output_path);
+		file << json;
+	}
+
+	return 0;
+}
@@ -32,12 +32,15 @@
 using namespace palmx;
 
 static void ProcessInput();
-static void UpdateTargetPosition();
+static void UpdateTargetPosition(float timestep);
 static void RenderGame();
 
 static Model target_dummy;
 static bool move_left = true;
-static const float move_speed = 250.0f;
+static const float move_speed = 4.0f;
+// The target is simulated at a fixed rate, rendering interpolates between the last two steps
+static glm::vec3 target_previous_position;
+static glm::vec3 target_position;
 
 static Sprite bullet_sprite;
 static Camera camera;
@@ -66,8 +69,17 @@ int main()
 		}
 
 		ProcessInput();
-		UpdateTargetPosition();
+
+		BeginDrawing(camera);
+
+		// The clock advances in BeginDrawing, step the simulation after it so the alpha covers only the remainder
+		while (StepFixedUpdate())
+		{
+			UpdateTargetPosition(GetFixedTimestep());
+		}
 		RenderGame();
+
+		EndDrawing();
 	}
 
 	Exit();
@@ -120,34 +132,31 @@ static void ProcessInput()
 	}
 }
 
-static void UpdateTargetPosition()
+static void UpdateTargetPosition(float timestep)
 {
-	auto& transform = target_dummy.transform;
+	target_previous_position = target_position;
 
 	if (move_left) {
-		target_dummy.transform.position.x -= move_speed * GetDeltaTime();
+		target_position.x -= move_speed * timestep;
 	}
 	else {
-		target_dummy.transform.position.x += move_speed * GetDeltaTime();
+		target_position.x += move_speed * timestep;
 	}
 
 	// Reverse direction when reaching the end
-	if (target_dummy.transform.position.x <= -8.0f) {
+	if (target_position.x <= -8.0f) {
 		move_left = false;
 	}
-	else if (target_dummy.transform.position.x >= 8.0f) {
+	else if (target_position.x >= 8.0f) {
 		move_left = true;
 	}
 }
 
 static void RenderGame()
 {
-	BeginDrawing(camera);
-
+	target_dummy.transform.position = glm::mix(target_previous_position, target_position, GetFixedAlpha());
 	DrawModel(target_dummy);
 
 	DrawSprite(bullet_sprite);
 	DrawString("Ammo: 69", glm::vec2(100.0f, 25.0f), 1.0f);
-
-	EndDrawing();
 }
\ No newline at end of file
@@ -36,10 +36,13 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
+#include <span>
+#include <unordered_map>
 
 namespace palmx
 {
@@ -210,27 +213,88 @@ namespace palmx
 		glm::vec3 rotation{ glm::vec3(0, 0, 0) }; // Euler Angles
 		glm::vec3 scale{ glm::vec3(1, 1, 1) };
 
+		// Translation * Rotation * Scale, composed directly instead of multiplying three matrices
 		glm::mat4 GetTransform() const
 		{
-			glm::mat4 rot = glm::toMat4(glm::quat(glm::radians(rotation)));
+			glm::mat4 matrix = glm::toMat4(glm::quat(glm::radians(rotation)));
+			matrix[0] *= scale.x;
+			matrix[1] *= scale.y;
+			matrix[2] *= scale.z;
+			matrix[3] = glm::vec4(position, 1.0f);
 
-			return glm::translate(glm::mat4(1.0f), position)
-				* rot
-				* glm::scale(glm::mat4(1.0f), scale);
+			return matrix;
 		}
 	};
 
+	// Handle of a transform in the transform store
+	using TransformId = uint32_t;
+
+	struct BoundingBox
+	{
+		glm::vec3 min{ glm::vec3(0, 0, 0) };
+		glm::vec3 max{ glm::vec3(0, 0, 0) };
+	};
+
+	struct BoundingSphere
+	{
+		glm::vec3 center{ glm::vec3(0, 0, 0) };
+		float radius{ 0 };
+	};
+
 	struct Camera
 	{
 		Transform transform;
 		float zoom{ 45 };
 	};
 
+	using ShaderLocation = uint8_t;
+	namespace shader_location
+	{
+		enum : ShaderLocation
+		{
+			// Uniforms used by the built-in shaders
+			Model = 0, /* u_Model */
+			ModelPosition, /* u_ModelPosition */
+			Color, /* u_Color */
+			Projection, /* u_Projection */
+			Texture, /* u_Texture */
+			TextureAlbedo, /* u_TextureAlbedo */
+			TextureNormal, /* u_TextureNormal */
+			PositionOffset, /* u_PositionOffset */
+			PositionScale, /* u_PositionScale */
+
+			Count
+		};
+	}
+
+	// Every shader can access the per-frame camera data by declaring the following block,
+	// which is bound automatically and updated once per frame in BeginDrawing:
+	//
+	//   layout (std140) uniform PalmxFrame
+	//   {
+	//       mat4 u_Projection;
+	//       mat4 u_View;
+	//       float u_Time;
+	//   };
 	struct Shader
 	{
-		unsigned int id;
+		unsigned int id{ 0 };
+		std::array<int, shader_location::Count> locations; // Built-in uniform locations (-1 if unused)
+		std::unordered_map<std::string, int> uniforms; // All active uniforms, resolved once at load time
 	};
 
+	// Vertex layout of a loaded mesh, chosen when the model is loaded
+	using VertexFormat = uint8_t;
+	namespace vertex_format
+	{
+		enum : VertexFormat
+		{
+			Standard = 0, // Vertex, 88 bytes
+			Static, // StaticVertex without skinning channels, 56 bytes
+			Compact // CompactVertex with quantized attributes, 16 bytes
+		};
+	}
+
 	struct Vertex
 	{
 		glm::vec3 position;
@@ -242,6 +306,22 @@ namespace palmx
 		float weights[4];
 	};
 
+	struct StaticVertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 tex_coords;
+		glm::vec3 tangent;
+		glm::vec3 bitangent;
+	};
+
+	struct CompactVertex
+	{
+		int16_t position[4]; // Normalized to the mesh bounds (see Mesh::position_offset), w is padding
+		uint32_t normal; // Octahedral encoded, two snorm16
+		uint32_t tex_coords; // Two half floats
+	};
+
 	struct Color
 	{
 		float r{ 1.0f };
@@ -252,7 +332,7 @@ namespace palmx
 
 	struct Texture
 	{
-		unsigned int id;
+		unsigned int id{ 0 }; // 0 if the texture failed to load
 	};
 
 	struct Sprite
@@ -260,28 +340,64 @@ namespace palmx
 		Transform transform;
 		Texture texture;
 		Color color = { 1.0f, 1.0f, 1.0f, 1.0f };
+		uint8_t layer{ 0 }; // Higher layers are drawn on top, within a layer sprites are drawn in call order
+
+		// Region of the texture the sprite shows, e.g. a sprite inside an atlas page
+		glm::vec2 uv_min{ glm::vec2(0, 0) };
+		glm::vec2 uv_max{ glm::vec2(1, 1) };
+	};
+
+	struct SpriteRegion
+	{
+		uint32_t page; // Index into SpriteAtlas::pages
+		glm::vec2 uv_min;
+		glm::vec2 uv_max;
+		glm::ivec2 size; // Size in pixels
+	};
+
+	// Atlas pages and lookup table written by the palmx_atlas_packer tool
+	struct SpriteAtlas
+	{
+		std::vector<Texture> pages;
+		std::unordered_map<std::string, SpriteRegion> regions; // Keyed by image path relative to the packed directory, without extension
 	};
 
 	struct Character
 	{
-		Texture texture; // The glyph texture
 		glm::ivec2   size; // Size of glyph
 		glm::ivec2   bearing; // Offset from baseline to left/top of glyph
 		unsigned int advance; // Horizontal offset to advance to next glyph
+		glm::vec2    uv_min; // Glyph rectangle inside the font atlas
+		glm::vec2    uv_max;
 	};
 
+	// Fonts contain the first 128 code points (ASCII)
+	const unsigned int font_glyph_count{ 128 };
+
 	struct Font
 	{
-		std::map<char, Character> characters;
+		Texture atlas; // All glyphs baked into a single texture
+		std::array<Character, font_glyph_count> characters; // Indexed by code point
 	};
 
 	struct Mesh
 	{
-		std::vector<Vertex>       vertices;
-		std::vector<unsigned int> indices;
+		VertexFormat format{ vertex_format::Standard };
+		uint32_t vertex_count{ 0 };
+		uint32_t index_count{ 0 };
+		unsigned int index_type{ 0 }; // GL_UNSIGNED_SHORT if the mesh has less than 65536 vertices, else GL_UNSIGNED_INT
+
+		// Object space position = position_offset + position_scale * vertex position
+		glm::vec3 position_offset{ glm::vec3(0, 0, 0) };
+		glm::vec3 position_scale{ glm::vec3(1, 1, 1) };
+
 		Texture albedo_texture;
 		Texture normal_texture;
 
+		// Object space bounds, computed when the mesh is loaded
+		BoundingBox bounding_box;
+		BoundingSphere bounding_sphere;
+
 		unsigned int vao;
 		unsigned int vbo;
 		unsigned int ebo;
@@ -298,11 +414,53 @@ namespace palmx
 		Transform transform;
 		Color color{ 1.0f, 1.0f, 1.0f, 1.0f };
 
+		BoundingBox bounding_box;
+		BoundingSphere bounding_sphere;
+
 		unsigned int vao;
 		unsigned int vbo;
 		unsigned int ebo;
 	};
 
+	struct RenderStats
+	{
+		uint32_t draw_calls{ 0 };
+		uint32_t program_binds{ 0 };
+		uint32_t vertex_array_binds{ 0 };
+		uint32_t texture_binds{ 0 };
+		uint32_t objects_drawn{ 0 }; // Models, primitives and instances that passed frustum culling
+		uint32_t objects_culled{ 0 }; // Models, primitives and instances outside of the camera frustum
+		uint32_t bytes_streamed{ 0 }; // Dynamic vertex, instance and uniform data written to the stream buffer
+	};
+
+	// Render passes of a frame that are timed on the GPU
+	using GpuPass = uint8_t;
+	namespace gpu_pass
+	{
+		enum : GpuPass
+		{
+			Scene = 0, // 3D geometry into the low resolution render texture
+			Ui, // Sprites and text into the render texture
+			Blit, // Render texture scaled onto the window
+			Count
+		};
+	}
+
+	struct GpuFrameTimings
+	{
+		uint64_t frame{ 0 };
+		float pass_ms[gpu_pass::Count]{}; // GPU time of each pass in milliseconds
+	};
+
+	// Handle of an object registered in the retained scene
+	using SceneHandle = uint32_t;
+
+	struct SceneRaycastHit
+	{
+		SceneHandle handle;
+		float distance; // Distance along the ray to the object's bounds
+	};
+
 	struct Rigidbody
 	{
 		glm::vec3 velocity;
@@ -341,8 +499,24 @@ namespace palmx
 	// Core
 	//----------------------------------------------------------------------------------
 
+	using InitFlags = uint8_t;
+	namespace init_flag
+	{
+		enum : InitFlags
+		{
+			None = 0,
+			// Render offscreen without a display or GPU (GLFW 3.4 null platform with OSMesa or EGL, e.g. Mesa's llvmpipe)
+			Headless = 1 << 0,
+			// Make the GL calls of a frame on a render thread that owns the context. EndDrawing hands the frame
+			// over and returns, so the game records the next frame while the last one is submitted. Loading and
+			// unloading assets waits until the render thread ran it between two frames. Render statistics and
+			// GPU timings trail one more frame behind.
+			RenderThread = 1 << 1
+		};
+	}
+
 	// Initialize window and OpenGL context.
-	extern void Init(std::string title, uint32_t width, uint32_t height);
+	extern void Init(std::string title, uint32_t width, uint32_t height, InitFlags flags = init_flag::None);
 	// Close window and unload OpenGL context.
 	extern void Exit();
 	// Was glfw requested to close the window?
@@ -351,9 +525,36 @@ namespace palmx
 	extern void RequestExit();
 
 	extern glm::vec2 GetWindowSize();
+	extern bool IsHeadless();
 
+	//----------------------------------------------------------------------------------
+	// Timing
+	//----------------------------------------------------------------------------------
+
+	// Seconds since Init, sampled on every call.
 	extern float GetTime();
+
+	// The frame clock is sampled once per frame in BeginDrawing, the functions below return the same values during a frame.
+
+	// Seconds since Init at the start of the current frame.
+	extern float GetFrameStartTime();
+	// Seconds between the start of the previous and the current frame, capped at a quarter second after stalls.
 	extern float GetDeltaTime();
+	// Number of frames started with BeginDrawing.
+	extern uint64_t GetFrameCount();
+	// Frame durations in milliseconds of up to the last frame_count frames, oldest first.
+	extern std::vector<float> GetFrameTimes(size_t frame_count);
+
+	// Simulation step length in seconds, defaults to 1/30 (30 Hz).
+	extern void SetFixedTimestep(float seconds);
+	extern float GetFixedTimestep();
+	// Consumes one fixed step of the accumulated frame time. Run the simulation after BeginDrawing as
+	// while (StepFixedUpdate()) { Simulate(GetFixedTimestep()); }
+	// so it advances at the same rate no matter how fast frames are rendered.
+	extern bool StepFixedUpdate();
+	// How far the accumulated time is into the next fixed step (0 to 1), for interpolating
+	// between the previous and the current simulation state when rendering. Only valid after the steps of the frame ran.
+	extern float GetFixedAlpha();
 
 	//----------------------------------------------------------------------------------
 	// Input
@@ -379,21 +580,59 @@ namespace palmx
 
 	// Setup canvas (framebuffer) to start drawing
 	extern void BeginDrawing(Camera& camera);
-	// End canvas drawing and swap buffers
+	// Submit everything drawn since BeginDrawing and swap buffers
 	extern void EndDrawing();
+	// Record the draw calls of the calling thread into its own list until EndDrawList, so any thread can
+	// prepare draws between BeginDrawing and EndDrawing. Recording makes no GL calls. Draws outside of a
+	// list have to come from the thread that called BeginDrawing. EndDrawing merges the lists in ascending
+	// order after those draws, so the frame is the same no matter which thread finished first. Every list
+	// has to be ended before EndDrawing, and transforms must not change while lists are recorded.
+	extern void BeginDrawList(uint32_t order);
+	extern void EndDrawList();
+	// Statistics of the last submitted frame
+	extern RenderStats GetRenderStats();
+	// GPU timings of up to the last frame_count frames, oldest first. Results are read back a few frames
+	// late so the CPU never waits for the GPU, frames whose results were not ready in time are skipped.
+	extern std::vector<GpuFrameTimings> GetGpuTimings(size_t frame_count);
 
 	extern void SetBackground(Color color);
 
 	extern Shader LoadShader(const std::string& vertex_shader_file_path, const std::string& fragment_shader_file_path);
 	extern Shader LoadShaderFromMemory(const std::string& vertex_shader_source, const std::string& fragment_shader_source);
+	// Get the cached location of a uniform (-1 if the shader has no active uniform with that name)
+	extern int GetShaderLocation(const Shader& shader, const std::string& uniform_name);
 
+	// Textures and models are cached by path, loading the same file again returns the already uploaded data.
+	// Every load has to be matched by an unload, the GPU data is released once the last user unloads it.
 	extern Texture LoadTexture(const std::string& file_path);
-
-	extern Model LoadModel(const std::string& file_path);
+	extern void UnloadTexture(const Texture& texture);
+	// Decode the texture on a worker thread. The returned texture shows a white placeholder until the
+	// decoded image was uploaded, uploads are spread over the following frames (see SetTextureUploadBudget).
+	extern Texture LoadTextureAsync(const std::string& file_path);
+	extern bool IsTextureReady(const Texture& texture);
+	// The texture keeps showing the placeholder, it still has to be unloaded. Loading the path again retries it.
+	extern bool IsTextureFailed(const Texture& texture);
+	// Maximum number of bytes uploaded by asynchronous texture loads per frame (at least one texture is uploaded per frame)
+	extern void SetTextureUploadBudget(size_t bytes_per_frame);
+
+	// Models share their meshes with every other load of the same file and format, only the transform is per model
+	extern Model LoadModel(const std::string& file_path, VertexFormat format = vertex_format::Standard);
+	extern void UnloadModel(const Model& model);
+	// Object space bounds enclosing all meshes of the model
+	extern BoundingBox GetModelBoundingBox(const Model& model);
 	extern void DrawModel(Model& model);
+	// Draw the model with the cached world matrix of a stored transform instead of model.transform
+	extern void DrawModel(const Model& model, TransformId transform);
+	// Draw a copy of the model for every transform, issuing a single draw call per mesh
+	extern void DrawModelInstanced(const Model& model, std::span<const Transform> transforms);
 
 	extern Primitive CreateCube();
+	// Copies of a primitive share its GL objects, unload only one of them
+	extern void UnloadPrimitive(const Primitive& primitive);
 	extern void DrawPrimitive(Primitive& primitive);
+	extern void DrawPrimitive(const Primitive& primitive, TransformId transform);
+	// Draw a copy of the primitive for every transform with a single draw call
+	extern void DrawPrimitiveInstanced(const Primitive& primitive, std::span<const Transform> transforms);
 
 	//----------------------------------------------------------------------------------
 	// User Interface
@@ -403,15 +642,72 @@ namespace palmx
 	extern Font LoadFont(const std::string& file_path);
 	extern void SetFont(const Font& new_font);
 
-	extern void DrawString(const std::string& text, glm::vec2 position, float scale, const Color& color = color_white);
+	// UI is drawn by layer and in call order within a layer. Only consecutive draws that share a texture are batched,
+	// so draw everything from one texture (e.g. an atlas page) together to keep the number of batches low.
+	extern void DrawString(const std::string& text, glm::vec2 position, float scale, const Color& color = color_white, uint8_t layer = 0);
 	extern void DrawSprite(const Sprite& sprite);
 
+	// Load an .atlas lookup table and its pages
+	extern SpriteAtlas LoadSpriteAtlas(const std::string& file_path);
+	// Create a sprite showing a region of the atlas (an untextured sprite if the atlas has no such region)
+	extern Sprite GetAtlasSprite(const SpriteAtlas& atlas, const std::string& name);
+
+	//----------------------------------------------------------------------------------
+	// Transforms
+	//----------------------------------------------------------------------------------
+
+	// The transform store keeps positions, rotations and scales in separate arrays and caches the world
+	// matrix of every transform. Matrices are only recomputed for transforms that changed since the last update.
+	extern TransformId CreateTransform(const Transform& transform = Transform());
+	extern void DestroyTransform(TransformId id);
+
+	extern void SetTransform(TransformId id, const Transform& transform);
+	extern void SetTransformPosition(TransformId id, glm::vec3 position);
+	extern void SetTransformRotation(TransformId id, glm::vec3 rotation);
+	extern void SetTransformScale(TransformId id, glm::vec3 scale);
+	extern Transform GetTransform(TransformId id);
+
+	// Recompute the world matrices of all changed transforms, called automatically by BeginDrawing
+	extern void UpdateTransforms();
+	// The reference is invalidated when a transform is created
+	extern const glm::mat4& GetWorldMatrix(TransformId id);
+
+	//----------------------------------------------------------------------------------
+	// Scene
+	//----------------------------------------------------------------------------------
+
+	// Register an object in the retained scene, which indexes it for hierarchical culling and spatial queries.
+	// The scene stores a reference, so the object must stay alive until it is removed. The initial
+	// transform is copied from the object, afterwards the scene transform replaces the object's transform.
+	extern SceneHandle AddToScene(const Model& model);
+	extern SceneHandle AddToScene(const Primitive& primitive);
+	extern SceneHandle AddToScene(const Sprite& sprite);
+	extern void RemoveFromScene(SceneHandle handle);
+
+	// Changed transforms are applied lazily the next time the scene is drawn or queried
+	extern void SetSceneTransform(SceneHandle handle, const Transform& transform);
+	extern Transform GetSceneTransform(SceneHandle handle);
+
+	// Draw every registered object that is inside the camera frustum (sprites: inside the window)
+	extern void DrawScene();
+
+	// Models and primitives whose bounds overlap the world space box
+	extern std::vector<SceneHandle> QueryScene(const BoundingBox& box);
+	// Sprites whose bounds overlap the screen space box (z is ignored)
+	extern std::vector<SceneHandle> QuerySceneSprites(const BoundingBox& screen_box);
+	// Closest model or primitive whose bounds are hit by the ray
+	extern bool RaycastScene(glm::vec3 origin, glm::vec3 direction, float max_distance, SceneRaycastHit& hit);
+
 	//----------------------------------------------------------------------------------
 	// Filesystem
 	//----------------------------------------------------------------------------------
 
 	extern std::string GetCurrentDir();
 	extern std::string GetResourceDir();
+	// Files inside a pack built by palmx_packer shadow loose files below the mount point,
+	// an empty mount point mounts the pack at the resource directory
+	extern bool MountPack(const std::string& file_path, const std::string& mount_point = "");
+	extern void UnmountPack(const std::string& file_path);
 }
 
 #endif // PALMX_H
\ No newline at end of file
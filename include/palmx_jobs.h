@@ -0,0 +1,88 @@
+/**********************************************************************************************
+*
+*   palmx - job system
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+
+#ifndef PALMX_JOBS_H
+#define PALMX_JOBS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace palmx
+{
+	struct JobConfig
+	{
+		uint32_t worker_count{ 0 }; // Zero starts one worker per hardware thread, minus the main thread
+		bool pin_threads{ false }; // Pin the main thread to the first core and every worker to a core of its own
+	};
+
+	using JobAffinity = uint8_t;
+	namespace job_affinity
+	{
+		enum : JobAffinity
+		{
+			Any = 0, // Any worker, or a thread that waits on a counter. Must not call into OpenGL.
+			// Runs when the thread that called Init reaches BeginDrawing or waits on a counter. May call into OpenGL.
+			// With the render thread enabled (see init_flag::RenderThread) the job is handed to the render thread
+			// and the main thread blocks until it ran.
+			MainThread = 1
+		};
+	}
+
+	// Number of unfinished jobs started with this counter. Jobs can wait for a counter to reach zero
+	// (see RunJobAfter) and waiting on it runs other jobs in the meantime. A counter has to outlive its jobs.
+	struct JobCounter
+	{
+		std::atomic<uint32_t> count{ 0 };
+		std::mutex mutex;
+		std::vector<std::function<void()>> dependents; // Scheduled once count reaches zero
+	};
+
+	// Has to be called before Init
+	extern void SetJobConfig(const JobConfig& config);
+	extern uint32_t GetJobWorkerCount();
+	extern bool IsMainThread();
+
+	// Queue a job. The counter is incremented right away and decremented once the job finished.
+	// Before Init and after Exit jobs run right away on the calling thread.
+	extern void RunJob(std::function<void()> job, JobCounter* counter = nullptr, JobAffinity affinity = job_affinity::Any);
+	// Queue a job once dependency reached zero
+	extern void RunJobAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr, JobAffinity affinity = job_affinity::Any);
+	// Block until counter reached zero, the calling thread runs queued jobs while it waits
+	extern void WaitForCounter(JobCounter& counter);
+	// Call function(i) for every i in [0, count), split into batches over the workers and the calling thread.
+	// Returns once all calls finished.
+	extern void ParallelFor(size_t count, const std::function<void(size_t)>& function);
+}
+
+#endif // PALMX_JOBS_H
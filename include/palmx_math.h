@@ -29,13 +29,30 @@
 #ifndef PALMX_MATH_H
 #define PALMX_MATH_H
 
+#include <palmx.h>
+
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 
 namespace palmx
 {
+    // Planes are stored as (normal, distance) with normals pointing into the frustum
+    struct Frustum
+    {
+        glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+    };
+
     extern glm::vec3 Vector3Forward(glm::vec3 vec3);
     extern glm::vec3 Vector3Right(glm::vec3 vec3);
     extern glm::vec3 Vector3Up(glm::vec3 vec3);
+
+    extern Frustum ExtractFrustum(const glm::mat4& view_projection);
+    extern bool IsSphereInFrustum(const Frustum& frustum, const BoundingSphere& sphere);
+    extern bool IsBoxInFrustum(const Frustum& frustum, const BoundingBox& box);
+
+    extern BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& transform);
+    extern BoundingSphere TransformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& transform);
 }
 
 #endif // PALMX_MATH_H
\ No newline at end of file
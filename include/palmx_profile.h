@@ -0,0 +1,73 @@
+/**********************************************************************************************
+*
+*   palmx - scope profiler
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_PROFILE_H
+#define PALMX_PROFILE_H
+
+#include <cstdint>
+#include <string>
+
+namespace palmx
+{
+	// Record the next frame_count frames (starting with the next BeginDrawing) and write them as
+	// Chrome trace-event JSON, viewable in chrome://tracing or Perfetto. Requires PALMX_PROFILE.
+	extern void StartProfileCapture(uint32_t frame_count, const std::string& file_path);
+	extern bool IsProfileCaptureRunning();
+}
+
+#ifdef PALMX_PROFILE
+
+namespace palmx::profiler
+{
+	// Times its own lifetime, the name must outlive the capture (e.g. a string literal)
+	struct Scope
+	{
+		explicit Scope(const char* name);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* name;
+		uint64_t start;
+	};
+}
+
+#define PALMX_PROFILE_CONCAT_INNER(a, b) a##b
+#define PALMX_PROFILE_CONCAT(a, b) PALMX_PROFILE_CONCAT_INNER(a, b)
+#define PALMX_PROFILE_SCOPE(name) ::palmx::profiler::Scope PALMX_PROFILE_CONCAT(palmx_profile_scope_, __LINE__)(name)
+
+#else
+
+#define PALMX_PROFILE_SCOPE(name) do { } while (false)
+
+#endif
+
+#endif // PALMX_PROFILE_H
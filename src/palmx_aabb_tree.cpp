@@ -0,0 +1,503 @@
+/**********************************************************************************************
+*
+*   palmx - dynamic AABB tree used for hierarchical culling and spatial queries
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include "palmx_aabb_tree.h"
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+namespace palmx
+{
+	static BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+	{
+		return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	static bool Contains(const BoundingBox& outer, const BoundingBox& inner)
+	{
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+			&& inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+	}
+
+	static bool Overlaps(const BoundingBox& a, const BoundingBox& b)
+	{
+		return a.min.x <= b.max.x && a.min.y <= b.max.y && a.min.z <= b.max.z
+			&& b.min.x <= a.max.x && b.min.y <= a.max.y && b.min.z <= a.max.z;
+	}
+
+	// Surface area heuristic, the cost of a node is proportional to the chance of a query hitting it
+	static float SurfaceArea(const BoundingBox& box)
+	{
+		glm::vec3 size = box.max - box.min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	enum class FrustumTest
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	static FrustumTest TestFrustum(const Frustum& frustum, const BoundingBox& box)
+	{
+		FrustumTest result = FrustumTest::Inside;
+
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			glm::vec3 normal = glm::vec3(plane);
+			glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y, plane.z >= 0.0f ? box.max.z : box.min.z);
+			glm::vec3 negative(plane.x >= 0.0f ? box.min.x : box.max.x, plane.y >= 0.0f ? box.min.y : box.max.y, plane.z >= 0.0f ? box.min.z : box.max.z);
+
+			if (glm::dot(normal, positive) + plane.w < 0.0f)
+				return FrustumTest::Outside;
+
+			if (glm::dot(normal, negative) + plane.w < 0.0f)
+				result = FrustumTest::Intersecting;
+		}
+
+		return result;
+	}
+
+	// Slab test, returns the entry distance or a negative value if the ray misses
+	static float IntersectRay(const BoundingBox& box, glm::vec3 origin, glm::vec3 inverse_direction, float max_distance)
+	{
+		float t_min = 0.0f;
+		float t_max = max_distance;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t1 = (box.min[axis] - origin[axis]) * inverse_direction[axis];
+			float t2 = (box.max[axis] - origin[axis]) * inverse_direction[axis];
+
+			t_min = glm::max(t_min, glm::min(t1, t2));
+			t_max = glm::min(t_max, glm::max(t1, t2));
+		}
+
+		return t_min <= t_max ? t_min : -1.0f;
+	}
+
+	AabbTree::AabbTree(float margin) : margin(margin)
+	{
+	}
+
+	int32_t AabbTree::AllocateNode()
+	{
+		int32_t node;
+		if (free_list != null_node)
+		{
+			node = free_list;
+			free_list = nodes[node].parent;
+		}
+		else
+		{
+			node = static_cast<int32_t>(nodes.size());
+			nodes.push_back({});
+		}
+
+		nodes[node].parent = null_node;
+		nodes[node].children[0] = null_node;
+		nodes[node].children[1] = null_node;
+		nodes[node].height = 0;
+		nodes[node].user_data = 0;
+		return node;
+	}
+
+	void AabbTree::FreeNode(int32_t node)
+	{
+		// Free nodes are chained through their parent index
+		nodes[node].parent = free_list;
+		nodes[node].height = -1;
+		free_list = node;
+	}
+
+	int32_t AabbTree::CreateProxy(const BoundingBox& box, uint32_t user_data)
+	{
+		int32_t proxy = AllocateNode();
+		nodes[proxy].box = { box.min - glm::vec3(margin), box.max + glm::vec3(margin) };
+		nodes[proxy].user_data = user_data;
+
+		InsertLeaf(proxy);
+		return proxy;
+	}
+
+	void AabbTree::DestroyProxy(int32_t proxy)
+	{
+		PALMX_ASSERT(nodes[proxy].IsLeaf(), "Proxy is not a leaf");
+
+		RemoveLeaf(proxy);
+		FreeNode(proxy);
+	}
+
+	bool AabbTree::MoveProxy(int32_t proxy, const BoundingBox& box)
+	{
+		PALMX_ASSERT(nodes[proxy].IsLeaf(), "Proxy is not a leaf");
+
+		// Small movements stay inside the fat box and don't touch the tree at all
+		if (Contains(nodes[proxy].box, box))
+			return false;
+
+		RemoveLeaf(proxy);
+		nodes[proxy].box = { box.min - glm::vec3(margin), box.max + glm::vec3(margin) };
+		InsertLeaf(proxy);
+		return true;
+	}
+
+	void AabbTree::InsertLeaf(int32_t leaf)
+	{
+		if (root == null_node)
+		{
+			root = leaf;
+			nodes[root].parent = null_node;
+			return;
+		}
+
+		// Descend to the sibling that increases the total surface area the least
+		BoundingBox leaf_box = nodes[leaf].box;
+		int32_t index = root;
+		while (!nodes[index].IsLeaf())
+		{
+			const Node& node = nodes[index];
+
+			float area = SurfaceArea(node.box);
+			float combined_area = SurfaceArea(Union(node.box, leaf_box));
+
+			// Cost of creating a new parent for this node and the new leaf
+			float cost = 2.0f * combined_area;
+			// Minimum cost of pushing the leaf further down the tree
+			float inheritance_cost = 2.0f * (combined_area - area);
+
+			float child_costs[2];
+			for (int i = 0; i < 2; i++)
+			{
+				const Node& child = nodes[node.children[i]];
+				float enlarged_area = SurfaceArea(Union(leaf_box, child.box));
+				child_costs[i] = (child.IsLeaf() ? enlarged_area : enlarged_area - SurfaceArea(child.box)) + inheritance_cost;
+			}
+
+			if (cost < child_costs[0] && cost < child_costs[1])
+				break;
+
+			index = child_costs[0] < child_costs[1] ? node.children[0] : node.children[1];
+		}
+
+		int32_t sibling = index;
+
+		// Create a new parent for the sibling and the leaf
+		int32_t old_parent = nodes[sibling].parent;
+		int32_t new_parent = AllocateNode();
+		nodes[new_parent].parent = old_parent;
+		nodes[new_parent].box = Union(leaf_box, nodes[sibling].box);
+		nodes[new_parent].height = nodes[sibling].height + 1;
+		nodes[new_parent].children[0] = sibling;
+		nodes[new_parent].children[1] = leaf;
+		nodes[sibling].parent = new_parent;
+		nodes[leaf].parent = new_parent;
+
+		if (old_parent != null_node)
+		{
+			int32_t child = nodes[old_parent].children[0] == sibling ? 0 : 1;
+			nodes[old_parent].children[child] = new_parent;
+		}
+		else
+		{
+			root = new_parent;
+		}
+
+		Refit(nodes[leaf].parent);
+	}
+
+	void AabbTree::RemoveLeaf(int32_t leaf)
+	{
+		if (leaf == root)
+		{
+			root = null_node;
+			return;
+		}
+
+		int32_t parent = nodes[leaf].parent;
+		int32_t grand_parent = nodes[parent].parent;
+		int32_t sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+		// The sibling takes the place of the parent
+		if (grand_parent != null_node)
+		{
+			int32_t child = nodes[grand_parent].children[0] == parent ? 0 : 1;
+			nodes[grand_parent].children[child] = sibling;
+			nodes[sibling].parent = grand_parent;
+			FreeNode(parent);
+
+			Refit(grand_parent);
+		}
+		else
+		{
+			root = sibling;
+			nodes[sibling].parent = null_node;
+			FreeNode(parent);
+		}
+	}
+
+	// Walk back up to the root, rebalancing and enlarging the ancestors
+	void AabbTree::Refit(int32_t node)
+	{
+		int32_t index = node;
+		while (index != null_node)
+		{
+			index = Balance(index);
+
+			int32_t child_0 = nodes[index].children[0];
+			int32_t child_1 = nodes[index].children[1];
+
+			nodes[index].height = 1 + glm::max(nodes[child_0].height, nodes[child_1].height);
+			nodes[index].box = Union(nodes[child_0].box, nodes[child_1].box);
+
+			index = nodes[index].parent;
+		}
+	}
+
+	// Rotate the taller child of node A up if the subtree is unbalanced, returns the new subtree root
+	int32_t AabbTree::Balance(int32_t index_a)
+	{
+		Node& a = nodes[index_a];
+		if (a.IsLeaf() || a.height < 2)
+			return index_a;
+
+		int32_t index_b = a.children[0];
+		int32_t index_c = a.children[1];
+		Node& b = nodes[index_b];
+		Node& c = nodes[index_c];
+
+		int32_t balance = c.height - b.height;
+
+		// Rotate C up
+		if (balance > 1)
+		{
+			int32_t index_f = c.children[0];
+			int32_t index_g = c.children[1];
+			Node& f = nodes[index_f];
+			Node& g = nodes[index_g];
+
+			// Swap A and C
+			c.children[0] = index_a;
+			c.parent = a.parent;
+			a.parent = index_c;
+
+			// A's old parent should point to C
+			if (c.parent != null_node)
+			{
+				int32_t child = nodes[c.parent].children[0] == index_a ? 0 : 1;
+				nodes[c.parent].children[child] = index_c;
+			}
+			else
+			{
+				root = index_c;
+			}
+
+			// Keep the taller grandchild under C
+			if (f.height > g.height)
+			{
+				c.children[1] = index_f;
+				a.children[1] = index_g;
+				g.parent = index_a;
+				a.box = Union(b.box, g.box);
+				c.box = Union(a.box, f.box);
+
+				a.height = 1 + glm::max(b.height, g.height);
+				c.height = 1 + glm::max(a.height, f.height);
+			}
+			else
+			{
+				c.children[1] = index_g;
+				a.children[1] = index_f;
+				f.parent = index_a;
+				a.box = Union(b.box, f.box);
+				c.box = Union(a.box, g.box);
+
+				a.height = 1 + glm::max(b.height, f.height);
+				c.height = 1 + glm::max(a.height, g.height);
+			}
+
+			return index_c;
+		}
+
+		// Rotate B up
+		if (balance < -1)
+		{
+			int32_t index_d = b.children[0];
+			int32_t index_e = b.children[1];
+			Node& d = nodes[index_d];
+			Node& e = nodes[index_e];
+
+			// Swap A and B
+			b.children[0] = index_a;
+			b.parent = a.parent;
+			a.parent = index_b;
+
+			// A's old parent should point to B
+			if (b.parent != null_node)
+			{
+				int32_t child = nodes[b.parent].children[0] == index_a ? 0 : 1;
+				nodes[b.parent].children[child] = index_b;
+			}
+			else
+			{
+				root = index_b;
+			}
+
+			// Keep the taller grandchild under B
+			if (d.height > e.height)
+			{
+				b.children[1] = index_d;
+				a.children[0] = index_e;
+				e.parent = index_a;
+				a.box = Union(c.box, e.box);
+				b.box = Union(a.box, d.box);
+
+				a.height = 1 + glm::max(c.height, e.height);
+				b.height = 1 + glm::max(a.height, d.height);
+			}
+			else
+			{
+				b.children[1] = index_e;
+				a.children[0] = index_d;
+				d.parent = index_a;
+				a.box = Union(c.box, d.box);
+				b.box = Union(a.box, e.box);
+
+				a.height = 1 + glm::max(c.height, d.height);
+				b.height = 1 + glm::max(a.height, e.height);
+			}
+
+			return index_b;
+		}
+
+		return index_a;
+	}
+
+	void AabbTree::Query(const BoundingBox& box, std::vector<uint32_t>& results) const
+	{
+		if (root == null_node)
+			return;
+
+		std::vector<int32_t> stack;
+		stack.push_back(root);
+
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			if (!Overlaps(node.box, box))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				results.push_back(node.user_data);
+			}
+			else
+			{
+				stack.push_back(node.children[0]);
+				stack.push_back(node.children[1]);
+			}
+		}
+	}
+
+	void AabbTree::Query(const Frustum& frustum, std::vector<FrustumResult>& results) const
+	{
+		if (root == null_node)
+			return;
+
+		// The second value marks subtrees already known to be completely inside the frustum
+		std::vector<std::pair<int32_t, bool>> stack;
+		stack.push_back({ root, false });
+
+		while (!stack.empty())
+		{
+			auto [index, inside] = stack.back();
+			stack.pop_back();
+
+			const Node& node = nodes[index];
+
+			if (!inside)
+			{
+				FrustumTest test = TestFrustum(frustum, node.box);
+				if (test == FrustumTest::Outside)
+					continue;
+
+				inside = test == FrustumTest::Inside;
+			}
+
+			if (node.IsLeaf())
+			{
+				results.push_back({ node.user_data, inside });
+			}
+			else
+			{
+				stack.push_back({ node.children[0], inside });
+				stack.push_back({ node.children[1], inside });
+			}
+		}
+	}
+
+	void AabbTree::Raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, std::vector<RaycastResult>& results) const
+	{
+		if (root == null_node)
+			return;
+
+		// Division by zero yields infinity, which the slab test handles correctly
+		glm::vec3 inverse_direction = glm::vec3(1.0f) / direction;
+
+		std::vector<int32_t> stack;
+		stack.push_back(root);
+
+		while (!stack.empty())
+		{
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+
+			float distance = IntersectRay(node.box, origin, inverse_direction, max_distance);
+			if (distance < 0.0f)
+				continue;
+
+			if (node.IsLeaf())
+			{
+				results.push_back({ node.user_data, distance });
+			}
+			else
+			{
+				stack.push_back(node.children[0]);
+				stack.push_back(node.children[1]);
+			}
+		}
+
+		std::sort(results.begin(), results.end(), [](const RaycastResult& a, const RaycastResult& b) { return a.distance < b.distance; });
+	}
+}
@@ -0,0 +1,101 @@
+/**********************************************************************************************
+*
+*   palmx - internal dynamic AABB tree header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_AABB_TREE_H
+#define PALMX_AABB_TREE_H
+
+#include <palmx.h>
+#include <palmx_math.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace palmx
+{
+	// Bounding volume hierarchy over fattened boxes (in the style of Box2D's dynamic tree).
+	// Leaves only need to be reinserted once an object leaves its fat box, and the tree is
+	// kept balanced with AVL-like rotations so queries stay logarithmic.
+	struct AabbTree
+	{
+		static const int32_t null_node = -1;
+
+		struct Node
+		{
+			BoundingBox box;
+			int32_t parent;
+			int32_t children[2];
+			int32_t height; // Leaves have a height of 0, free nodes -1
+			uint32_t user_data;
+
+			bool IsLeaf() const { return children[0] == null_node; }
+		};
+
+		struct FrustumResult
+		{
+			uint32_t user_data;
+			bool fully_inside; // The leaf's box is entirely inside the frustum, no further tests needed
+		};
+
+		struct RaycastResult
+		{
+			uint32_t user_data;
+			float distance;
+		};
+
+		explicit AabbTree(float margin);
+
+		int32_t CreateProxy(const BoundingBox& box, uint32_t user_data);
+		void DestroyProxy(int32_t proxy);
+		// Returns true if the proxy had to be reinserted because it left its fat box
+		bool MoveProxy(int32_t proxy, const BoundingBox& box);
+
+		uint32_t GetUserData(int32_t proxy) const { return nodes[proxy].user_data; }
+		const BoundingBox& GetFatBox(int32_t proxy) const { return nodes[proxy].box; }
+
+		void Query(const BoundingBox& box, std::vector<uint32_t>& results) const;
+		void Query(const Frustum& frustum, std::vector<FrustumResult>& results) const;
+		// Hits against leaf boxes along the ray, sorted by distance
+		void Raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, std::vector<RaycastResult>& results) const;
+
+	private:
+		int32_t AllocateNode();
+		void FreeNode(int32_t node);
+		void InsertLeaf(int32_t leaf);
+		void RemoveLeaf(int32_t leaf);
+		int32_t Balance(int32_t node);
+		void Refit(int32_t node);
+
+		std::vector<Node> nodes;
+		int32_t root{ null_node };
+		int32_t free_list{ null_node };
+		float margin;
+	};
+}
+
+#endif // PALMX_AABB_TREE_H
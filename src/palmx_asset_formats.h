@@ -0,0 +1,163 @@
+/**********************************************************************************************
+*
+*   palmx - internal cooked asset formats header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_ASSET_FORMATS_H
+#define PALMX_ASSET_FORMATS_H
+
+#include <cstdint>
+#include <string_view>
+
+// Binary layouts of the files written by the asset tools. Everything is little endian and
+// read straight out of a memory mapped file, so the structs must not contain padding.
+namespace palmx::asset_format
+{
+	// .pxtex layout:
+	//   TextureHeader
+	//   TextureLevel[level_count]   Largest level first
+	//   Pixel data                  Rows tightly packed, ready for glTexImage2D with an unpack alignment of 1
+	const char texture_magic[4] = { 'P', 'X', 'T', 'X' };
+	const uint32_t texture_version = 1;
+
+	struct TextureHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t components; // 1 (red), 3 (RGB) or 4 (RGBA), 8 bit each
+		uint32_t level_count;
+	};
+
+	struct TextureLevel
+	{
+		uint64_t offset; // From the start of the file
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	static_assert(sizeof(TextureHeader) == 24, "TextureHeader must not contain padding");
+	static_assert(sizeof(TextureLevel) == 24, "TextureLevel must not contain padding");
+
+	// .pxmesh layout:
+	//   MeshHeader
+	//   MeshRecord[mesh_count]
+	//   Material names, vertex and index data   Vertex and index data is aligned to 16 bytes
+	const char mesh_magic[4] = { 'P', 'X', 'M', 'S' };
+	const uint32_t mesh_version = 1;
+
+	struct MeshHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t mesh_count;
+		uint32_t reserved;
+	};
+
+	struct MeshRecord
+	{
+		uint32_t vertex_format; // VertexFormat the vertex data is stored in
+		uint32_t vertex_count;
+		uint32_t index_count;
+		uint32_t index_size; // 2 or 4 bytes
+
+		float position_offset[3];
+		float position_scale[3];
+		float bounds_min[3];
+		float bounds_max[3];
+		float sphere_center[3];
+		float sphere_radius;
+
+		// Offsets from the start of the file
+		uint64_t vertex_offset;
+		uint64_t vertex_data_size;
+		uint64_t index_offset;
+		uint64_t index_data_size;
+		uint64_t material_offset;
+		uint32_t material_length;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(MeshHeader) == 16, "MeshHeader must not contain padding");
+	static_assert(sizeof(MeshRecord) == 128, "MeshRecord must not contain padding");
+
+	// .pxpack layout:
+	//   PackHeader
+	//   File data and paths
+	//   PackEntry[entry_count]   Sorted by path hash, so a lookup is a binary search
+	const char pack_magic[4] = { 'P', 'X', 'P', 'K' };
+	const uint32_t pack_version = 1;
+
+	struct PackHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entry_count;
+		uint32_t reserved;
+		uint64_t index_offset;
+	};
+
+	using PackCompression = uint32_t;
+	namespace pack_compression
+	{
+		enum : PackCompression
+		{
+			None = 0,
+			Lz = 1
+		};
+	}
+
+	struct PackEntry
+	{
+		uint64_t path_hash;
+		uint64_t offset;
+		uint64_t stored_size; // Size inside the pack
+		uint64_t size; // Size after decompression
+		uint64_t path_offset; // The path is kept to tell hash collisions apart
+		uint32_t path_length;
+		PackCompression compression;
+	};
+
+	static_assert(sizeof(PackHeader) == 24, "PackHeader must not contain padding");
+	static_assert(sizeof(PackEntry) == 48, "PackEntry must not contain padding");
+
+	// FNV-1a over the path relative to the pack root, with forward slashes
+	inline uint64_t HashPath(std::string_view path)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : path)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+#endif // PALMX_ASSET_FORMATS_H
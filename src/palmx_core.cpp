@@ -28,8 +28,11 @@
 
 #include "pxpch.h"
 #include "palmx_core.h"
+#include "palmx_frame_clock.h"
 #include "palmx_graphics.h"
 #include "palmx_input.h"
+#include "palmx_job_system.h"
+#include "palmx_render_thread.h"
 #include "palmx_ui.h"
 
 namespace palmx
@@ -43,6 +46,13 @@ namespace palmx
 
 	static void GLFWFramebufferSizeCallback(GLFWwindow* window, int width, int height)
 	{
+		// Events are polled on the game thread, the GL calls have to be made on the render thread
+		if (!render_thread::IsContextThread())
+		{
+			render_thread::Run([=]() { GLFWFramebufferSizeCallback(window, width, height); });
+			return;
+		}
+
 		// Make sure the viewport matches the new window dimensions; note that width and 
 		// height will be significantly larger than specified on retina displays.
 		glViewport(0, 0, width, height);
@@ -50,10 +60,21 @@ namespace palmx
 		ui::OnWindowResize(width, height);
 	}
 
-	void Init(std::string title, uint32_t width, uint32_t height)
+	void Init(std::string title, uint32_t width, uint32_t height, InitFlags flags)
 	{
 		PALMX_ASSERT(!px_data.init, "palmx cannot be initialized twice");
 
+		bool headless = (flags & init_flag::Headless) != 0;
+		if (headless)
+		{
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+			// The null platform needs no display server, the context is created by OSMesa or EGL
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+			PALMX_WARN("Headless mode needs GLFW 3.4 or newer, falling back to a hidden window");
+#endif
+		}
+
 		int success = glfwInit();
 		PALMX_ASSERT(success, "Could not initialize GLFW");
 		glfwSetErrorCallback(GLFWErrorCallback);
@@ -66,12 +87,31 @@ namespace palmx
 		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-		PALMX_INFO("Creating window " << title << " (" << width << ", " << height << ")");
+		if (headless)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+		}
+
+		PALMX_INFO("Creating " << (headless ? "headless " : "") << "window " << title << " (" << width << ", " << height << ")");
 
 		px_data.init = true;
 		px_data.title = title;
+		px_data.headless = headless;
 		px_data.window = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
 
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+		if (px_data.window == nullptr && headless)
+		{
+			// Newer Mesa releases dropped OSMesa, EGL can still create a context without a display
+			PALMX_INFO("OSMesa is not available, retrying with EGL");
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+			px_data.window = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
+		}
+#endif
+
 		if (px_data.window == nullptr)
 		{
 			glfwTerminate();
@@ -83,15 +123,25 @@ namespace palmx
 		glfwSetFramebufferSizeCallback(px_data.window, GLFWFramebufferSizeCallback);
 
 		input::Init();
+		job_system::Init();
 		graphics::Init();
 		ui::Init();
+		frame_clock::Init();
 
 		// Manually call resize function as part of the initialization process
 		ui::OnWindowResize(width, height);
+
+		if (flags & init_flag::RenderThread)
+		{
+			render_thread::Init();
+		}
 	}
 
 	void Exit()
 	{
+		// Jobs may still load or unload assets through the render thread
+		job_system::Shutdown();
+		render_thread::Shutdown();
 		glfwTerminate();
 	}
 
@@ -120,19 +170,8 @@ namespace palmx
 		return { width, height };
 	}
 
-	float GetTime()
+	bool IsHeadless()
 	{
-		return static_cast<float>(glfwGetTime());
-	}
-
-	float delta_time = 0.0f;
-	float last_frame = 0.0f;
-	float GetDeltaTime()
-	{
-		float current_frame = static_cast<float>(glfwGetTime());
-		delta_time = current_frame - last_frame;
-		last_frame = current_frame;
-
-		return delta_time;
+		return px_data.headless;
 	}
 }
\ No newline at end of file
@@ -41,6 +41,7 @@ namespace palmx
 
 		std::string title;
 		GLFWwindow* window;
+		bool headless{ false }; // Frames are presented into an offscreen framebuffer instead of a window
 	};
 
 	extern PxData px_data;
@@ -0,0 +1,135 @@
+/**********************************************************************************************
+*
+*   palmx - frame clock with fixed timestep accumulation
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include <chrono>
+
+#include "palmx_frame_clock.h"
+#include "palmx_history.h"
+
+namespace palmx
+{
+	using Clock = std::chrono::steady_clock;
+
+	// A stall (loading, debugger, dragged window) must not turn into one huge simulation step
+	static const double max_delta_time{ 0.25 };
+	// Drop accumulated time instead of falling further behind when simulation is slower than real time
+	static const uint32_t max_fixed_steps_per_frame{ 8 };
+
+	static Clock::time_point start_time;
+	static double frame_time{ 0.0 };
+	static double delta_time{ 0.0 };
+	static uint64_t frame_count{ 0 };
+
+	static double fixed_timestep{ 1.0 / 30.0 };
+	static double fixed_accumulator{ 0.0 };
+
+	static History<float, 240> history;
+
+	void frame_clock::Init()
+	{
+		start_time = Clock::now();
+		frame_time = 0.0;
+		delta_time = 0.0;
+		frame_count = 0;
+		fixed_accumulator = 0.0;
+
+		history.Clear();
+	}
+
+	void frame_clock::Tick()
+	{
+		double now = std::chrono::duration<double>(Clock::now() - start_time).count();
+		double frame_duration = now - frame_time;
+		frame_time = now;
+
+		// The first frame has no previous frame to measure against
+		if (frame_count++ == 0)
+			return;
+
+		delta_time = std::min(frame_duration, max_delta_time);
+		fixed_accumulator = std::min(fixed_accumulator + delta_time, fixed_timestep * max_fixed_steps_per_frame);
+
+		// The history keeps the real frame duration, also for stalls
+		history.Push(static_cast<float>(frame_duration * 1000.0));
+	}
+
+	float GetTime()
+	{
+		return std::chrono::duration<float>(Clock::now() - start_time).count();
+	}
+
+	float GetFrameStartTime()
+	{
+		return static_cast<float>(frame_time);
+	}
+
+	float GetDeltaTime()
+	{
+		return static_cast<float>(delta_time);
+	}
+
+	uint64_t GetFrameCount()
+	{
+		return frame_count;
+	}
+
+	void SetFixedTimestep(float seconds)
+	{
+		PALMX_ASSERT((seconds > 0.0f), "Fixed timestep has to be positive");
+
+		// Keep the interpolation alpha where it was relative to the new step
+		fixed_accumulator = fixed_accumulator / fixed_timestep * seconds;
+		fixed_timestep = seconds;
+	}
+
+	float GetFixedTimestep()
+	{
+		return static_cast<float>(fixed_timestep);
+	}
+
+	bool StepFixedUpdate()
+	{
+		if (fixed_accumulator < fixed_timestep)
+			return false;
+
+		fixed_accumulator -= fixed_timestep;
+		return true;
+	}
+
+	float GetFixedAlpha()
+	{
+		return static_cast<float>(std::clamp(fixed_accumulator / fixed_timestep, 0.0, 1.0));
+	}
+
+	std::vector<float> GetFrameTimes(size_t frame_count)
+	{
+		return history.GetLatest(frame_count);
+	}
+}
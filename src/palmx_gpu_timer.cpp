@@ -0,0 +1,137 @@
+/**********************************************************************************************
+*
+*   palmx - per pass GPU timings through timer queries
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include <glad/glad.h>
+
+#include "palmx_gpu_timer.h"
+#include "palmx_history.h"
+
+#include <mutex>
+
+namespace palmx
+{
+	// Results are read back this many frames later, by then the GPU has long finished them
+	static const uint32_t frames_in_flight{ 3 };
+
+	struct QueryFrame
+	{
+		GLuint queries[gpu_pass::Count];
+		bool used[gpu_pass::Count];
+		uint64_t frame;
+		bool pending;
+	};
+
+	static QueryFrame query_frames[frames_in_flight];
+	static uint32_t current_query_frame{ 0 };
+	static uint64_t frame_index{ 0 };
+	static int running_pass{ -1 };
+
+	static History<GpuFrameTimings, 240> history;
+	static std::mutex history_mutex; // Written by the render thread, read by the game
+
+	void gpu_timer::Init()
+	{
+		for (QueryFrame& query_frame : query_frames)
+		{
+			glGenQueries(gpu_pass::Count, query_frame.queries);
+			query_frame.pending = false;
+		}
+	}
+
+	void gpu_timer::BeginPass(GpuPass pass)
+	{
+		EndPass();
+
+		QueryFrame& query_frame = query_frames[current_query_frame];
+		glBeginQuery(GL_TIME_ELAPSED, query_frame.queries[pass]);
+		query_frame.used[pass] = true;
+		running_pass = pass;
+	}
+
+	void gpu_timer::EndPass()
+	{
+		if (running_pass < 0)
+			return;
+
+		glEndQuery(GL_TIME_ELAPSED);
+		running_pass = -1;
+	}
+
+	static void ReadResults(QueryFrame& query_frame)
+	{
+		GpuFrameTimings timings = {};
+		timings.frame = query_frame.frame;
+
+		for (uint32_t pass = 0; pass < gpu_pass::Count; pass++)
+		{
+			if (!query_frame.used[pass])
+				continue;
+
+			GLint available = 0;
+			glGetQueryObjectiv(query_frame.queries[pass], GL_QUERY_RESULT_AVAILABLE, &available);
+			// Never wait for the GPU, a frame that is not done yet is dropped from the history
+			if (!available)
+				return;
+
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query_frame.queries[pass], GL_QUERY_RESULT, &elapsed);
+			timings.pass_ms[pass] = static_cast<float>(elapsed / 1e6);
+		}
+
+		std::lock_guard<std::mutex> lock(history_mutex);
+		history.Push(timings);
+	}
+
+	void gpu_timer::EndFrame()
+	{
+		EndPass();
+
+		QueryFrame& query_frame = query_frames[current_query_frame];
+		query_frame.frame = frame_index++;
+		query_frame.pending = true;
+
+		// The oldest frame in flight gets reused next, collect it first
+		current_query_frame = (current_query_frame + 1) % frames_in_flight;
+		QueryFrame& next_frame = query_frames[current_query_frame];
+		if (next_frame.pending)
+		{
+			ReadResults(next_frame);
+			next_frame.pending = false;
+		}
+
+		std::fill(std::begin(next_frame.used), std::end(next_frame.used), false);
+	}
+
+	std::vector<GpuFrameTimings> GetGpuTimings(size_t frame_count)
+	{
+		std::lock_guard<std::mutex> lock(history_mutex);
+		return history.GetLatest(frame_count);
+	}
+}
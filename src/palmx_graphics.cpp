@@ -29,16 +29,23 @@
 #include "pxpch.h"
 #include <glad/glad.h>
 
+#include "palmx_asset_formats.h"
 #include "palmx_core.h"
+#include "palmx_frame_clock.h"
+#include "palmx_gpu_timer.h"
 #include "palmx_graphics.h"
+#include "palmx_job_system.h"
+#include "palmx_model_import.h"
+#include "palmx_profiler.h"
+#include "palmx_render_queue.h"
+#include "palmx_render_thread.h"
+#include "palmx_stream_buffer.h"
+#include "palmx_ui.h"
+#include "palmx_vfs.h"
 
 #include <palmx.h>
 #include <palmx_math.h>
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
 #include <stb_image.h>
 
 #include <glm/glm.hpp>
@@ -51,12 +58,19 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <filesystem>
+#include <deque>
+#include <mutex>
 
 namespace palmx
 {
 	GLuint render_texture;
 	GLuint render_texture_framebuffer;
 
+	// Stands in for the default framebuffer in headless mode, where a context may have no surface
+	GLuint backbuffer_framebuffer{ 0 };
+
 	// PlayStation 1 display was 320x240px or 640x480px
 	const unsigned int render_texture_width{ 320 };
 	const unsigned int render_texture_height{ 240 };
@@ -66,10 +80,118 @@ namespace palmx
 	Shader fullscreen_quad_shader;
 
 	Shader model_shader;
+	Shader model_instanced_shader;
 	Shader primitive_shader;
+	Shader primitive_instanced_shader;
+
+	// Instanced shaders read the model matrix from this vertex attribute (occupies 4 locations)
+	const GLuint instance_attribute_location{ 7 };
+	GLuint frame_instance_buffer{ 0 }; // Location of this frame's instance matrices in the stream buffer
+	size_t frame_instance_offset{ 0 };
+	bool frame_instances_streamed{ false }; // Instanced draws are skipped if the matrices could not be mapped
+
+	// Camera data shared by all shaders through the PalmxFrame uniform block (std140 layout)
+	struct FrameUniforms
+	{
+		glm::mat4 projection;
+		glm::mat4 view;
+		float time;
+		float padding[3];
+	};
+
+	const GLuint frame_uniform_block_binding{ 0 };
+	GLint uniform_buffer_alignment{ 256 };
+
+	FrameUniforms frame_uniforms;
+	glm::vec3 camera_position;
+	Frustum camera_frustum;
+
+	const float camera_near_plane{ 0.1f };
+	const float camera_far_plane{ 100.0f };
 
 	Color background_color{ color_black };
 
+	// Everything the GL side of a frame reads, the game thread can record the next frame meanwhile
+	struct FrameSnapshot
+	{
+		render_queue::DrawList list;
+		FrameUniforms uniforms;
+		Color background_color;
+		glm::vec2 window_size;
+		uint64_t frame{ 0 };
+	};
+
+	static FrameSnapshot render_frame;
+
+	// Commands keep referencing GL objects until their frame was submitted, so unloading only queues the delete.
+	// Objects are deleted after the frame that was recorded when they were unloaded, the driver keeps them
+	// alive for the GPU from there on.
+	enum class GlObjectType : uint8_t
+	{
+		Texture,
+		VertexArray,
+		Buffer
+	};
+
+	struct PendingDelete
+	{
+		GlObjectType type;
+		GLuint name;
+		uint64_t frame;
+	};
+
+	static std::vector<PendingDelete> pending_deletes; // Only touched on the context thread
+
+	// Loaded assets keyed by path, with reverse lookups so unloading works with the returned handle
+	struct TextureCacheEntry
+	{
+		Texture texture;
+		uint32_t references;
+	};
+
+	struct ModelCacheEntry
+	{
+		std::vector<Mesh> meshes;
+		uint32_t references;
+	};
+
+	static std::unordered_map<std::string, TextureCacheEntry> texture_cache;
+	static std::unordered_map<unsigned int, std::string> texture_cache_paths;
+	static std::unordered_map<std::string, ModelCacheEntry> model_cache;
+	static std::unordered_map<unsigned int, std::string> model_cache_keys; // Keyed by the vertex array of the first mesh
+
+	// Textures decoded by worker threads, waiting to be uploaded on the main thread
+	struct DecodedTexture
+	{
+		unsigned int id;
+		uint64_t ticket;
+		std::string path;
+		int width;
+		int height;
+		int num_components;
+		unsigned char* data; // Allocated by stb_image, nullptr if decoding failed
+	};
+
+	static std::mutex decoded_textures_mutex;
+	static std::deque<DecodedTexture> decoded_textures;
+	static std::unordered_map<unsigned int, uint64_t> pending_textures; // Texture name to ticket of its running load, guarded by the mutex above
+	static std::unordered_map<unsigned int, uint32_t> failed_textures; // Texture name to references, no longer cached so the path can be retried
+	static uint64_t next_texture_ticket{ 0 };
+	static size_t texture_upload_budget{ 4 * 1024 * 1024 };
+
+	// Pixel unpack buffers reused by the uploads, the fence signals when the transfer out of a buffer is done
+	struct PixelBuffer
+	{
+		GLuint id{ 0 };
+		size_t size{ 0 };
+		GLsync fence{ nullptr };
+	};
+
+	static const uint32_t pixel_buffer_count{ 4 };
+	static PixelBuffer pixel_buffers[pixel_buffer_count];
+	static uint32_t next_pixel_buffer{ 0 };
+	static std::vector<unsigned int> mipmap_textures; // Uploaded last frame, mipmaps are generated once their transfer had time to finish
+
 	enum class ShaderType
 	{
 		VERTEX,
@@ -77,6 +199,17 @@ namespace palmx
 		PROGRAM
 	};
 
+	// Insert a preprocessor define right after the #version directive of a shader
+	static std::string AddShaderDefine(const std::string& source, const std::string& define)
+	{
+		size_t version = source.find("#version");
+		size_t insert_position = (version == std::string::npos) ? 0 : source.find('\n', version) + 1;
+
+		std::string result = source;
+		result.insert(insert_position, "#define " + define + "\n");
+		return result;
+	}
+
 	void graphics::Init()
 	{
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
@@ -119,6 +252,29 @@ namespace palmx
 		GLenum draw_buffers[1] = { GL_COLOR_ATTACHMENT0 };
 		glDrawBuffers(1, draw_buffers);
 
+		if (px_data.headless)
+		{
+			// The window of the null platform never resizes, so the backbuffer keeps its initial size
+			int window_width, window_height;
+			glfwGetFramebufferSize(px_data.window, &window_width, &window_height);
+
+			glGenFramebuffers(1, &backbuffer_framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, backbuffer_framebuffer);
+
+			GLuint backbuffer_renderbuffer;
+			glGenRenderbuffers(1, &backbuffer_renderbuffer);
+			glBindRenderbuffer(GL_RENDERBUFFER, backbuffer_renderbuffer);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width, window_height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, backbuffer_renderbuffer);
+			glDrawBuffers(1, draw_buffers);
+		}
+
+		// The per-frame camera data is streamed, its range is bound every frame
+		stream_buffer::Init();
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_buffer_alignment);
+
+		gpu_timer::Init();
+
 		GLfloat quad_vertices[] = {
 			-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, // Bottom-left vertex
 			1.0f, -1.0f, 0.0f, 1.0f, 0.0f,  // Bottom-right vertex
@@ -178,20 +334,42 @@ namespace palmx
             layout (location = 0) in vec3 a_Position;
             layout (location = 1) in vec3 a_Normal;
             layout (location = 2) in vec2 a_TexCoord;
+#ifdef PALMX_INSTANCED
+            layout (location = 7) in mat4 a_InstanceModel;
+#endif
 
             noperspective out vec2 v_TexCoord;
 
+            layout (std140) uniform PalmxFrame
+            {
+                mat4 u_Projection;
+                mat4 u_View;
+                float u_Time;
+            };
+
             uniform mat4 u_Model;
-            uniform mat4 u_View;
-            uniform mat4 u_Projection;
+
+            // Compact meshes store positions normalized to their bounds
+            uniform vec3 u_PositionOffset;
+            uniform vec3 u_PositionScale;
 
 			uniform vec3 u_ModelPosition;
 			const float jitterAmount = 0.005;
 
             void main()
             {
+#ifdef PALMX_INSTANCED
+				mat4 model = a_InstanceModel;
+				vec3 modelPosition = a_InstanceModel[3].xyz;
+#else
+				mat4 model = u_Model;
+				vec3 modelPosition = u_ModelPosition;
+#endif
+
+				vec3 position = u_PositionOffset + u_PositionScale * a_Position;
+
 				// Calculate world space position of the vertex
-				vec3 worldPosition = (u_Model * vec4(a_Position, 1.0)).xyz + u_ModelPosition;
+				vec3 worldPosition = (model * vec4(position, 1.0)).xyz + modelPosition;
 
 				// Apply vertex jitter
 				vec3 jitter = vec3(
@@ -200,9 +378,9 @@ namespace palmx
 					0.0
 				) * jitterAmount;
 
-				vec3 jitterPosition = a_Position + jitter;
+				vec3 jitterPosition = position + jitter;
 
-				gl_Position = u_Projection * u_View * u_Model * vec4(jitterPosition, 1.0);
+				gl_Position = u_Projection * u_View * model * vec4(jitterPosition, 1.0);
 
                 v_TexCoord = a_TexCoord;
             }
@@ -226,19 +404,40 @@ namespace palmx
         )";
 
 		model_shader = LoadShaderFromMemory(model_vertex_shader_source, model_fragment_shader_source);
+		model_instanced_shader = LoadShaderFromMemory(AddShaderDefine(model_vertex_shader_source, "PALMX_INSTANCED"), model_fragment_shader_source);
+
+		// Samplers always use the same texture units, so they only need to be set once
+		for (const Shader& shader : { model_shader, model_instanced_shader })
+		{
+			glUseProgram(shader.id);
+			glUniform1i(shader.locations[shader_location::TextureAlbedo], 0);
+			glUniform1i(shader.locations[shader_location::TextureNormal], 1);
+		}
 
 		std::string primitive_vertex_shader_source = R"(
             #version 330 core
 
             layout (location = 0) in vec3 a_Position;
+#ifdef PALMX_INSTANCED
+            layout (location = 7) in mat4 a_InstanceModel;
+#endif
+
+            layout (std140) uniform PalmxFrame
+            {
+                mat4 u_Projection;
+                mat4 u_View;
+                float u_Time;
+            };
 
             uniform mat4 u_Model;
-            uniform mat4 u_View;
-            uniform mat4 u_Projection;
 
             void main()
             {
+#ifdef PALMX_INSTANCED
+                gl_Position = u_Projection * u_View * a_InstanceModel * vec4(a_Position, 1.0);
+#else
                 gl_Position = u_Projection * u_View * u_Model * vec4(a_Position, 1.0);
+#endif
             }
         )";
 
@@ -256,44 +455,161 @@ namespace palmx
         )";
 
 		primitive_shader = LoadShaderFromMemory(primitive_vertex_shader_source, primitive_fragment_shader_source);
+		primitive_instanced_shader = LoadShaderFromMemory(AddShaderDefine(primitive_vertex_shader_source, "PALMX_INSTANCED"), primitive_fragment_shader_source);
 	}
 
 	void BeginDrawing(Camera& camera)
 	{
+		// Captures start and end on frame boundaries, before the first scope of the frame opens
+		profiler::BeginFrame();
+
+		PALMX_PROFILE_SCOPE("BeginDrawing");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
+		frame_clock::Tick();
+
 		glfwPollEvents();
 
+		int framebuffer_width, framebuffer_height;
+		glfwGetFramebufferSize(px_data.window, &framebuffer_width, &framebuffer_height);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), static_cast<float>(framebuffer_width) / static_cast<float>(framebuffer_height), camera_near_plane, camera_far_plane);
+		glm::mat4 view = glm::lookAt(camera.transform.position, camera.transform.position + Vector3Forward(camera.transform.rotation), Vector3Up(camera.transform.rotation));
+
+		frame_uniforms = { projection, view, GetFrameStartTime() };
+		camera_position = camera.transform.position;
+		camera_frustum = ExtractFrustum(projection * view);
+
+		// Static transforms are not touched, only the ones changed since the last frame
+		UpdateTransforms();
+
+		job_system::RunMainThreadJobs();
+
+		// Draw calls are only recorded until the frame is submitted in EndDrawing
+		render_queue::Begin();
+	}
+
+	static void DeleteAfterFrame(GlObjectType type, GLuint name)
+	{
+		pending_deletes.push_back({ type, name, GetFrameCount() });
+	}
+
+	static void DeletePendingObjects(uint64_t submitted_frame)
+	{
+		std::erase_if(pending_deletes, [submitted_frame](const PendingDelete& pending) {
+			if (pending.frame > submitted_frame)
+				return false;
+
+			switch (pending.type)
+			{
+			case GlObjectType::Texture:
+				glDeleteTextures(1, &pending.name);
+				break;
+			case GlObjectType::VertexArray:
+				glDeleteVertexArrays(1, &pending.name);
+				break;
+			case GlObjectType::Buffer:
+				glDeleteBuffers(1, &pending.name);
+				break;
+			}
+
+			return true;
+		});
+	}
+
+	void EndDrawing()
+	{
+		PALMX_PROFILE_SCOPE("EndDrawing");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		// Everything recorded on other threads has to be done by now, their lists join the frame here
+		render_queue::DrawList& frame_list = render_queue::Merge();
+
+		// The render thread reads the snapshot until it finished the last frame
+		render_thread::WaitForFrame();
+
+		// Swapping hands over the recorded frame without copying, the old snapshot is cleared in BeginDrawing
+		std::swap(render_frame.list, frame_list);
+		render_frame.uniforms = frame_uniforms;
+		render_frame.background_color = background_color;
+		render_frame.window_size = GetWindowSize();
+		render_frame.frame = GetFrameCount();
+
+		if (render_thread::IsEnabled())
+		{
+			render_thread::StartFrame();
+			return;
+		}
+
+		graphics::RenderFrame();
+	}
+
+	void graphics::RenderFrame()
+	{
+		PALMX_PROFILE_SCOPE("RenderFrame");
+
+		render_queue::DrawList& frame_list = render_frame.list;
+		const Color& background_color = render_frame.background_color;
+
+		UploadDecodedTextures();
+
+		render_queue::ResetStats(frame_list);
+		stream_buffer::BeginFrame();
+
 		glClearColor(background_color.r, background_color.g, background_color.b, background_color.a);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Render the scene at a lower resolution to emulate the PS1 screen
 		// Everything below will now be rendered to the render texture instead of the screen directly
+		gpu_timer::BeginPass(gpu_pass::Scene);
 		glBindFramebuffer(GL_FRAMEBUFFER, render_texture_framebuffer);
 		glViewport(0, 0, render_texture_width, render_texture_height);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		int framebuffer_width, framebuffer_height;
-		glfwGetFramebufferSize(px_data.window, &framebuffer_width, &framebuffer_height);
-		glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), static_cast<float>(framebuffer_width) / static_cast<float>(framebuffer_height), 0.1f, 100.0f);
-		glm::mat4 view = glm::lookAt(camera.transform.position, camera.transform.position + Vector3Forward(camera.transform.rotation), Vector3Up(camera.transform.rotation));
+		// Stream the camera data once, every shader reads it from the shared uniform block
+		// Mapping can fail on the orphaning path, the frame is then drawn with what could be streamed
+		stream_buffer::Allocation frame_allocation = stream_buffer::Allocate(sizeof(FrameUniforms), uniform_buffer_alignment);
+		if (frame_allocation.data != nullptr)
+		{
+			std::memcpy(frame_allocation.data, &render_frame.uniforms, sizeof(FrameUniforms));
+			stream_buffer::Commit(frame_allocation);
+			glBindBufferRange(GL_UNIFORM_BUFFER, frame_uniform_block_binding, frame_allocation.buffer, frame_allocation.offset, sizeof(FrameUniforms));
+		}
+		else
+		{
+			PALMX_ERROR("Failed to map the stream buffer for the frame uniforms");
+		}
 
-		glUseProgram(model_shader.id);
-		glUniformMatrix4fv(glGetUniformLocation(model_shader.id, "u_Projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(glGetUniformLocation(model_shader.id, "u_View"), 1, GL_FALSE, glm::value_ptr(view));
+		// Stream all instance matrices of the frame at once
+		frame_instances_streamed = false;
+		if (!frame_list.instance_transforms.empty())
+		{
+			size_t size = frame_list.instance_transforms.size() * sizeof(glm::mat4);
+			stream_buffer::Allocation instance_allocation = stream_buffer::Allocate(size, sizeof(glm::mat4));
+			if (instance_allocation.data != nullptr)
+			{
+				std::memcpy(instance_allocation.data, frame_list.instance_transforms.data(), size);
+				stream_buffer::Commit(instance_allocation);
+				frame_instance_buffer = instance_allocation.buffer;
+				frame_instance_offset = instance_allocation.offset;
+				frame_instances_streamed = true;
+			}
+			else
+			{
+				PALMX_ERROR("Failed to map the stream buffer for " << frame_list.instance_transforms.size() << " instance matrices");
+			}
+		}
 
-		glUseProgram(primitive_shader.id);
-		glUniformMatrix4fv(glGetUniformLocation(primitive_shader.id, "u_Projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(glGetUniformLocation(primitive_shader.id, "u_View"), 1, GL_FALSE, glm::value_ptr(view));
-	}
+		render_queue::Submit(frame_list);
+		stream_buffer::EndFrame();
 
-	void EndDrawing()
-	{
-		PALMX_ASSERT(px_data.init, "palmx not initialized");
+		DeletePendingObjects(render_frame.frame);
 
 		// Reset the viewport to the size of the window
-		auto window_size = GetWindowSize();
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		gpu_timer::BeginPass(gpu_pass::Blit);
+		glm::vec2 window_size = render_frame.window_size;
+		glBindFramebuffer(GL_FRAMEBUFFER, backbuffer_framebuffer);
 		glViewport(0, 0, window_size.x, window_size.y);
 
 		glUseProgram(fullscreen_quad_shader.id);
@@ -307,6 +623,15 @@ namespace palmx
 		glBindVertexArray(0);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
+		gpu_timer::EndFrame();
+
+		if (px_data.headless)
+		{
+			// There is nothing to present, but the frame still has to reach the driver
+			glFlush();
+			return;
+		}
+
 		glfwSwapBuffers(px_data.window);
 	}
 
@@ -339,10 +664,71 @@ namespace palmx
 		}
 	}
 
+	static const char* shader_location_names[shader_location::Count] = {
+		"u_Model",
+		"u_ModelPosition",
+		"u_Color",
+		"u_Projection",
+		"u_Texture",
+		"u_TextureAlbedo",
+		"u_TextureNormal",
+		"u_PositionOffset",
+		"u_PositionScale"
+	};
+
+	// Query all active uniforms of a linked program once, so drawing never has to look them up by name
+	Shader ReflectShader(GLuint id)
+	{
+		Shader shader = {};
+		shader.id = id;
+		shader.locations.fill(-1);
+
+		GLint uniform_count = 0;
+		glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &uniform_count);
+
+		for (GLint i = 0; i < uniform_count; i++)
+		{
+			char name[256];
+			GLsizei length;
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(id, i, sizeof(name), &length, &size, &type, name);
+
+			// Uniforms that are part of a block don't have a location
+			GLint location = glGetUniformLocation(id, name);
+			if (location == -1)
+				continue;
+
+			// Arrays are reported as "name[0]"
+			std::string uniform_name(name, length);
+			if (uniform_name.ends_with("[0]"))
+				uniform_name.resize(uniform_name.size() - 3);
+
+			shader.uniforms[uniform_name] = location;
+		}
+
+		for (ShaderLocation i = 0; i < shader_location::Count; i++)
+		{
+			shader.locations[i] = GetShaderLocation(shader, shader_location_names[i]);
+		}
+
+		// Connect the shader to the per-frame uniform buffer if it declares the block
+		GLuint frame_block_index = glGetUniformBlockIndex(id, "PalmxFrame");
+		if (frame_block_index != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(id, frame_block_index, frame_uniform_block_binding);
+		}
+
+		return shader;
+	}
+
 	Shader CompileShader(std::string vertex_shader_source, std::string fragment_shader_source)
 	{
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { return CompileShader(vertex_shader_source, fragment_shader_source); });
+
 		const GLchar* vertex_shader_code = vertex_shader_source.c_str();
 		const GLchar* fragment_shader_code = fragment_shader_source.c_str();
 
@@ -368,46 +754,31 @@ namespace palmx
 		glDeleteShader(vertex_shader);
 		glDeleteShader(fragment_shader);
 
-		return Shader(id);
+		return ReflectShader(id);
 	}
 
 	Shader LoadShader(const std::string& vertex_shader_file_path, const std::string& fragment_shader_file_path)
 	{
+		PALMX_PROFILE_SCOPE("LoadShader");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		// Retrieve the vertex/fragment source code from filePath
-		std::string vertex_shader_code;
-		std::string fragment_shader_code;
-		std::ifstream vertex_shader_file;
-		std::ifstream fragment_shader_file;
-		// Ensures ifstream objects can throw exceptions:
-		vertex_shader_file.exceptions(std::ifstream::badbit);
-		fragment_shader_file.exceptions(std::ifstream::badbit);
-		try
-		{
-			// Open files
-			vertex_shader_file.open(vertex_shader_file_path);
-			fragment_shader_file.open(fragment_shader_file_path);
-			std::stringstream vertex_shader_stream, fragment_shader_stream;
-			// Read file's buffer contents into streams
-			vertex_shader_stream << vertex_shader_file.rdbuf();
-			fragment_shader_stream << fragment_shader_file.rdbuf();
-			// close file handlers
-			vertex_shader_file.close();
-			fragment_shader_file.close();
-			// Convert stream into string
-			vertex_shader_code = vertex_shader_stream.str();
-			fragment_shader_code = fragment_shader_stream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
-			PALMX_ERROR("Shader file not successfully read:\n" << e.what()
+		vfs::File vertex_shader_file;
+		vfs::File fragment_shader_file;
+		if (!vfs::ReadFile(vertex_shader_file_path, vertex_shader_file) || !vfs::ReadFile(fragment_shader_file_path, fragment_shader_file))
+		{
+			PALMX_ERROR("Shader file not successfully read"
 				<< "\nVertex shader path: " << vertex_shader_file_path
 				<< "\nFragment shader path: " << fragment_shader_file_path
 			);
-			return Shader();
+			Shader shader = {};
+			shader.locations.fill(-1);
+			return shader;
 		}
 
+		std::string vertex_shader_code(reinterpret_cast<const char*>(vertex_shader_file.data), vertex_shader_file.size);
+		std::string fragment_shader_code(reinterpret_cast<const char*>(fragment_shader_file.data), fragment_shader_file.size);
+
 		const GLchar* vertex_shader_code_c = vertex_shader_code.c_str();
 		const GLchar* fragment_shader_code_c = fragment_shader_code.c_str();
 
@@ -421,94 +792,556 @@ namespace palmx
 		return CompileShader(vertex_shader_source, fragment_shader_source);
 	}
 
-	Texture LoadTexture(const std::string& file_path)
+	int GetShaderLocation(const Shader& shader, const std::string& uniform_name)
 	{
-		PALMX_ASSERT(px_data.init, "palmx not initialized");
+		auto it = shader.uniforms.find(uniform_name);
+		if (it == shader.uniforms.end())
+			return -1;
+
+		return it->second;
+	}
+
+	static GLenum GetTextureFormat(int num_components)
+	{
+		GLenum format = GL_RGB;
+		if (num_components == 1)
+			format = GL_RED;
+		else if (num_components == 3)
+			format = GL_RGB;
+		else if (num_components == 4)
+			format = GL_RGBA;
+
+		return format;
+	}
+
+	// Upload decoded pixels to the bound texture, pixels is an offset if a pixel unpack buffer is bound
+	// Generating the mipmaps waits for the upload, asynchronous uploads generate them a frame later instead.
+	static void UploadTextureImage(int width, int height, int num_components, const void* pixels, bool generate_mipmaps)
+	{
+		GLenum format = GetTextureFormat(num_components);
+
+		// Rows of 1 and 3 component images are not 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		if (generate_mipmaps)
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	// Cooked files are used in place of the source asset if they are at least as new
+	static std::string FindCookedFile(const std::string& file_path, const char* cooked_extension)
+	{
+		std::filesystem::path path(file_path);
+		if (path.extension() == cooked_extension)
+			return file_path;
+
+		std::filesystem::path cooked_path = path;
+		cooked_path.replace_extension(cooked_extension);
+
+		// Packs are built from cooked output, so a packed cooked file is always current
+		if (vfs::IsPacked(cooked_path.string()))
+			return cooked_path.string();
+
+		std::error_code error;
+		auto cooked_time = std::filesystem::last_write_time(cooked_path, error);
+		if (error)
+			return "";
+
+		auto source_time = std::filesystem::last_write_time(path, error);
+		if (!error && source_time > cooked_time)
+			return "";
+
+		return cooked_path.string();
+	}
+
+	// Upload every level of a cooked texture straight from the mapped file, nothing is decoded
+	static Texture LoadCookedTexture(const std::string& file_path)
+	{
+		vfs::File file;
+		if (!vfs::ReadFile(file_path, file))
+		{
+			PALMX_ERROR("Failed to open cooked texture at path: " << file_path);
+			return Texture();
+		}
+
+		const uint8_t* data = file.data;
+		size_t size = file.size;
+
+		asset_format::TextureHeader header;
+		if (size < sizeof(header))
+		{
+			PALMX_ERROR("Cooked texture is truncated: " << file_path);
+			return Texture();
+		}
+
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, asset_format::texture_magic, sizeof(header.magic)) != 0 || header.version != asset_format::texture_version)
+		{
+			PALMX_ERROR("Cooked texture has an unknown format or version: " << file_path);
+			return Texture();
+		}
+
+		if (header.level_count == 0 || sizeof(header) + header.level_count * sizeof(asset_format::TextureLevel) > size)
+		{
+			PALMX_ERROR("Cooked texture is truncated: " << file_path);
+			return Texture();
+		}
+
+		GLenum format = GetTextureFormat(header.components);
 
 		unsigned int texture_id;
 		glGenTextures(1, &texture_id);
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-		int width, height, num_components;
-		unsigned char* data = stbi_load(file_path.c_str(), &width, &height, &num_components, 0);
-		if (data)
+		for (uint32_t i = 0; i < header.level_count; i++)
 		{
-			GLenum format = GL_RGB;
-			if (num_components == 1)
-				format = GL_RED;
-			else if (num_components == 3)
-				format = GL_RGB;
-			else if (num_components == 4)
-				format = GL_RGBA;
+			asset_format::TextureLevel level;
+			std::memcpy(&level, data + sizeof(header) + i * sizeof(level), sizeof(level));
+			if (level.offset > size || level.size > size - level.offset)
+			{
+				PALMX_ERROR("Cooked texture is truncated: " << file_path);
+				glDeleteTextures(1, &texture_id);
+				return Texture();
+			}
 
-			glBindTexture(GL_TEXTURE_2D, texture_id);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, data + level.offset);
+		}
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.level_count - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-			stbi_image_free(data);
-		}
-		else
+		return { texture_id };
+	}
+
+	// Decode an image file into pixels that have to be freed with stbi_image_free, safe to call on worker threads
+	static unsigned char* DecodeImage(const std::string& file_path, int& width, int& height, int& num_components)
+	{
+		PALMX_PROFILE_SCOPE("DecodeImage");
+
+		vfs::File file;
+		if (!vfs::ReadFile(file_path, file))
+			return nullptr;
+
+		return stbi_load_from_memory(file.data, static_cast<int>(file.size), &width, &height, &num_components, 0);
+	}
+
+	// Decode and upload a texture without going through the cache
+	static Texture LoadTextureFromFile(const std::string& file_path)
+	{
+		std::string cooked_path = FindCookedFile(file_path, ".pxtex");
+		if (!cooked_path.empty())
+			return LoadCookedTexture(cooked_path);
+
+		int width, height, num_components;
+		unsigned char* data = DecodeImage(file_path, width, height, num_components);
+		if (!data)
 		{
 			PALMX_ERROR("Failed to load texture at path: " << file_path);
-			stbi_image_free(data);
+			return Texture();
 		}
 
+		unsigned int texture_id;
+		glGenTextures(1, &texture_id);
+
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		UploadTextureImage(width, height, num_components, data, true);
+
+		stbi_image_free(data);
+
 		return { texture_id };
 	}
 
-	Mesh ProcessMesh(aiMesh* ai_mesh, const aiScene* ai_scene, std::string directory)
+	Texture LoadTexture(const std::string& file_path)
 	{
+		PALMX_PROFILE_SCOPE("LoadTexture");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		Mesh mesh = {};
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { return LoadTexture(file_path); });
 
-		for (unsigned int i = 0; i < ai_mesh->mNumVertices; i++)
+		auto it = texture_cache.find(file_path);
+		if (it != texture_cache.end())
 		{
-			Vertex vertex;
+			it->second.references++;
+			return it->second.texture;
+		}
 
-			// Process vertex positions, normals and texture coordinates
-			glm::vec3 vec3;
-			vec3.x = ai_mesh->mVertices[i].x;
-			vec3.y = ai_mesh->mVertices[i].y;
-			vec3.z = ai_mesh->mVertices[i].z;
-			vertex.position = vec3;
+		// Failed loads are not cached, so a file that appears later can still be loaded
+		Texture texture = LoadTextureFromFile(file_path);
+		if (texture.id != 0)
+		{
+			texture_cache[file_path] = { texture, 1 };
+			texture_cache_paths[texture.id] = file_path;
+		}
 
-			vec3.x = ai_mesh->mNormals[i].x;
-			vec3.y = ai_mesh->mNormals[i].y;
-			vec3.z = ai_mesh->mNormals[i].z;
-			vertex.normal = vec3;
+		return texture;
+	}
 
-			if (ai_mesh->mTextureCoords[0]) // Does the ai_mesh contain texture coordinates?
+	void UnloadTexture(const Texture& texture)
+	{
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { UnloadTexture(texture); });
+
+		auto path = texture_cache_paths.find(texture.id);
+		if (path == texture_cache_paths.end())
+		{
+			std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+			auto failed = failed_textures.find(texture.id);
+			if (failed != failed_textures.end() && --failed->second == 0)
 			{
-				glm::vec2 vec2;
-				vec2.x = ai_mesh->mTextureCoords[0][i].x;
-				vec2.y = ai_mesh->mTextureCoords[0][i].y;
-				vertex.tex_coords = vec2;
+				DeleteAfterFrame(GlObjectType::Texture, texture.id);
+				failed_textures.erase(failed);
 			}
-			else
+			return;
+		}
+
+		auto it = texture_cache.find(path->second);
+		if (--it->second.references > 0)
+			return;
+
+		DeleteAfterFrame(GlObjectType::Texture, texture.id);
+		texture_cache.erase(it);
+		texture_cache_paths.erase(path);
+		std::erase(mipmap_textures, texture.id);
+
+		// A decode that is still running is dropped when it finishes
+		std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+		pending_textures.erase(texture.id);
+	}
+
+	Texture LoadTextureAsync(const std::string& file_path)
+	{
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { return LoadTextureAsync(file_path); });
+
+		auto it = texture_cache.find(file_path);
+		if (it != texture_cache.end())
+		{
+			it->second.references++;
+			return it->second.texture;
+		}
+
+		// Cooked textures need no decoding, they are uploaded right away
+		if (!FindCookedFile(file_path, ".pxtex").empty())
+			return LoadTexture(file_path);
+
+		// The texture name is valid right away, the decoded image replaces the placeholder later
+		const unsigned char placeholder_pixel[4] = { 255, 255, 255, 255 };
+
+		unsigned int texture_id;
+		glGenTextures(1, &texture_id);
+		glBindTexture(GL_TEXTURE_2D, texture_id);
+		UploadTextureImage(1, 1, 4, placeholder_pixel, true);
+
+		texture_cache[file_path] = { { texture_id }, 1 };
+		texture_cache_paths[texture_id] = file_path;
+
+		// GL may reuse the name after an unload, the ticket tells the results of both loads apart
+		uint64_t ticket = next_texture_ticket++;
+		{
+			std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+			pending_textures[texture_id] = ticket;
+		}
+
+		RunJob([texture_id, ticket, file_path]() {
+			DecodedTexture decoded = {};
+			decoded.id = texture_id;
+			decoded.ticket = ticket;
+			decoded.path = file_path;
+			decoded.data = DecodeImage(file_path, decoded.width, decoded.height, decoded.num_components);
+
+			std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+			decoded_textures.push_back(std::move(decoded));
+		});
+
+		return { texture_id };
+	}
+
+	bool IsTextureReady(const Texture& texture)
+	{
+		std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+		return texture.id != 0 && !pending_textures.contains(texture.id) && !failed_textures.contains(texture.id);
+	}
+
+	bool IsTextureFailed(const Texture& texture)
+	{
+		std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+		return texture.id == 0 || failed_textures.contains(texture.id);
+	}
+
+	void SetTextureUploadBudget(size_t bytes_per_frame)
+	{
+		std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+		texture_upload_budget = bytes_per_frame;
+	}
+
+	// Upload decoded textures through pixel buffer objects until the frame's budget is used up
+	void graphics::UploadDecodedTextures()
+	{
+		PALMX_PROFILE_SCOPE("UploadDecodedTextures");
+
+		for (unsigned int texture_id : mipmap_textures)
+		{
+			glBindTexture(GL_TEXTURE_2D, texture_id);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		mipmap_textures.clear();
+
+		std::vector<DecodedTexture> uploads;
+		size_t budget;
+		{
+			std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+			budget = texture_upload_budget;
+
+			size_t bytes = 0;
+			while (!decoded_textures.empty())
+			{
+				const DecodedTexture& next = decoded_textures.front();
+				size_t size = static_cast<size_t>(next.width) * next.height * next.num_components;
+
+				// Always make progress, even if a single texture exceeds the budget
+				if (!uploads.empty() && bytes + size > budget)
+					break;
+
+				bytes += size;
+				uploads.push_back(std::move(decoded_textures.front()));
+				decoded_textures.pop_front();
+			}
+		}
+
+		for (size_t i = 0; i < uploads.size(); i++)
+		{
+			DecodedTexture& decoded = uploads[i];
+
+			// Never wait for the GPU, if the next buffer is still being read the rest waits for the next frame
+			PixelBuffer& pixel_buffer = pixel_buffers[next_pixel_buffer];
+			if (pixel_buffer.fence != nullptr)
+			{
+				if (glClientWaitSync(pixel_buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				{
+					std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+					decoded_textures.insert(decoded_textures.begin(), std::make_move_iterator(uploads.begin() + i), std::make_move_iterator(uploads.end()));
+					break;
+				}
+
+				glDeleteSync(pixel_buffer.fence);
+				pixel_buffer.fence = nullptr;
+			}
+
+			bool unloaded;
+			{
+				std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+				auto pending = pending_textures.find(decoded.id);
+				unloaded = pending == pending_textures.end() || pending->second != decoded.ticket;
+				if (!unloaded)
+					pending_textures.erase(pending);
+			}
+
+			if (unloaded)
+			{
+				// The texture was unloaded while it was decoding
+				stbi_image_free(decoded.data);
+				continue;
+			}
+
+			// Like failed synchronous loads, failed decodes are not cached. The handle keeps the placeholder
+			// until it is unloaded, each reference handed out for the path still has to be released.
+			if (decoded.data == nullptr)
+			{
+				PALMX_ERROR("Failed to load texture at path: " << decoded.path);
+
+				auto it = texture_cache.find(decoded.path);
+				std::lock_guard<std::mutex> lock(decoded_textures_mutex);
+				failed_textures[decoded.id] = it->second.references;
+				texture_cache.erase(it);
+				texture_cache_paths.erase(decoded.id);
+				continue;
+			}
+
+			size_t size = static_cast<size_t>(decoded.width) * decoded.height * decoded.num_components;
+
+			// The buffers share the budget, larger textures grow the buffer they end up in
+			if (pixel_buffer.id == 0)
+				glGenBuffers(1, &pixel_buffer.id);
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.id);
+			if (pixel_buffer.size < size)
+			{
+				pixel_buffer.size = std::max(size, budget / pixel_buffer_count);
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.size, nullptr, GL_STREAM_DRAW);
+			}
+
+			// The fence above guarantees the previous transfer out of this buffer is done
+			void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (mapped != nullptr)
 			{
-				vertex.tex_coords = glm::vec2(0.0f, 0.0f);
+				std::memcpy(mapped, decoded.data, size);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+				// The copy into the texture returns immediately, the driver transfers it asynchronously
+				glBindTexture(GL_TEXTURE_2D, decoded.id);
+				UploadTextureImage(decoded.width, decoded.height, decoded.num_components, nullptr, false);
+
+				pixel_buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				next_pixel_buffer = (next_pixel_buffer + 1) % pixel_buffer_count;
+				mipmap_textures.push_back(decoded.id);
 			}
 
-			mesh.vertices.push_back(vertex);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			stbi_image_free(decoded.data);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Point the attributes of the bound vertex array at the bound vertex buffer
+	static void SetVertexAttributes(VertexFormat format)
+	{
+		switch (format)
+		{
+		case vertex_format::Standard:
+		{
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+			glEnableVertexAttribArray(4);
+			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+			// IDs
+			glEnableVertexAttribArray(5);
+			glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, bone_ids));
+			// Weights
+			glEnableVertexAttribArray(6);
+			glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, weights));
+			break;
+		}
+		case vertex_format::Static:
+		{
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, tex_coords));
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, tangent));
+			glEnableVertexAttribArray(4);
+			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, bitangent));
+			break;
+		}
+		case vertex_format::Compact:
+		{
+			// Normalized attributes are converted back to floats by the vertex fetch
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, tex_coords));
+			break;
+		}
+		default:
+			PALMX_ERROR("Unknown vertex format " << static_cast<int>(format));
+			break;
+		}
+	}
+
+	static std::string GetMaterialTexturePath(const std::string& directory, const std::string& material_name, const char* type)
+	{
+		return directory + "/" + material_name + "_texture_" + type + ".png";
+	}
+
+	// Decode the textures of all materials in parallel and upload them into the cache. The loading model
+	// holds one reference to each of them until its meshes are created, it has to release the returned textures.
+	static std::vector<Texture> PreloadMaterialTextures(const std::vector<const model_import::MeshInfo*>& meshes, const std::string& directory)
+	{
+		PALMX_PROFILE_SCOPE("PreloadMaterialTextures");
+
+		std::vector<std::string> file_paths;
+		for (const model_import::MeshInfo* info : meshes)
+		{
+			for (const char* type : { "albedo", "normal" })
+			{
+				std::string file_path = GetMaterialTexturePath(directory, info->material_name, type);
+				if (texture_cache.contains(file_path) || std::find(file_paths.begin(), file_paths.end(), file_path) != file_paths.end())
+					continue;
+
+				// Cooked textures need no decoding
+				if (!FindCookedFile(file_path, ".pxtex").empty())
+					continue;
+
+				file_paths.push_back(file_path);
+			}
 		}
 
-		// Process indices
-		for (unsigned int i = 0; i < ai_mesh->mNumFaces; i++)
+		struct Image
+		{
+			int width{ 0 };
+			int height{ 0 };
+			int num_components{ 0 };
+			unsigned char* data{ nullptr };
+		};
+
+		std::vector<Image> images(file_paths.size());
+		ParallelFor(file_paths.size(), [&](size_t i) {
+			images[i].data = DecodeImage(file_paths[i], images[i].width, images[i].height, images[i].num_components);
+		});
+
+		// Failed decodes are left to LoadTexture, which reports them
+		std::vector<Texture> preloaded;
+		for (size_t i = 0; i < file_paths.size(); i++)
 		{
-			aiFace face = ai_mesh->mFaces[i];
-			for (unsigned int j = 0; j < face.mNumIndices; j++)
-				mesh.indices.push_back(face.mIndices[j]);
+			if (images[i].data == nullptr)
+				continue;
+
+			unsigned int texture_id;
+			glGenTextures(1, &texture_id);
+			glBindTexture(GL_TEXTURE_2D, texture_id);
+			UploadTextureImage(images[i].width, images[i].height, images[i].num_components, images[i].data, true);
+			stbi_image_free(images[i].data);
+
+			texture_cache[file_paths[i]] = { { texture_id }, 1 };
+			texture_cache_paths[texture_id] = file_paths[i];
+			preloaded.push_back({ texture_id });
 		}
 
+		return preloaded;
+	}
+
+	// Create the GPU buffers of a mesh, the vertices and indices are already in GPU layout
+	static Mesh CreateMesh(const model_import::MeshInfo& info, const void* vertices, size_t vertices_size, const void* indices, size_t indices_size, const std::string& directory)
+	{
+		Mesh mesh = {};
+		mesh.format = info.format;
+		mesh.vertex_count = info.vertex_count;
+		mesh.index_count = info.index_count;
+		mesh.index_type = info.index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		mesh.position_offset = info.position_offset;
+		mesh.position_scale = info.position_scale;
+		mesh.bounding_box = info.bounding_box;
+		mesh.bounding_sphere = info.bounding_sphere;
+
 		// Load Materials
-		std::string material_name = ai_scene->mMaterials[ai_mesh->mMaterialIndex]->GetName().C_Str();
-		mesh.albedo_texture = LoadTexture(std::string(directory + "/" + material_name + "_texture_albedo.png"));
-		mesh.normal_texture = LoadTexture(std::string(directory + "/" + material_name + "_texture_normal.png"));
+		mesh.albedo_texture = LoadTexture(GetMaterialTexturePath(directory, info.material_name, "albedo"));
+		mesh.normal_texture = LoadTexture(GetMaterialTexturePath(directory, info.material_name, "normal"));
 
 		// Create buffers/arrays
 		glGenVertexArrays(1, &mesh.vao);
@@ -516,136 +1349,325 @@ namespace palmx
 		glGenBuffers(1, &mesh.ebo);
 
 		glBindVertexArray(mesh.vao);
-		// Load data into vertex buffers
+		// Load data into vertex buffers and set the vertex attribute pointers
 		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-		// A great thing about structs is that their memory layout is sequential for all its items.
-		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-		// Again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Vertex), &mesh.vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
+		SetVertexAttributes(mesh.format);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), &mesh.indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, indices, GL_STATIC_DRAW);
 
-		// Set the vertex attribute pointers
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		// Vertex normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-		// Vertex texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
-		// Vertex tangent
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-		// Vertex bitangent
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-		// IDs
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, bone_ids));
-		// Weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, weights));
 		glBindVertexArray(0);
 
 		return mesh;
 	}
 
-	std::vector<Mesh> ProcessNode(aiNode* ai_node, const aiScene* ai_scene, std::string directory)
+	// Upload every mesh of a .pxmesh file straight from the mapping
+	static bool LoadCookedModel(const std::string& file_path, VertexFormat format, const std::string& directory, Model& model)
 	{
-		PALMX_ASSERT(px_data.init, "palmx not initialized");
-
-		std::vector<Mesh> meshes = std::vector<Mesh>();
+		vfs::File file;
+		if (!vfs::ReadFile(file_path, file))
+		{
+			PALMX_ERROR("Failed to open cooked model at path: " << file_path);
+			return false;
+		}
 
-		// Process all the ai_node's meshes (if any)
-		for (unsigned int i = 0; i < ai_node->mNumMeshes; i++)
+		std::vector<model_import::MeshView> meshes;
+		if (!model_import::ReadCookedModel(file.data, file.size, meshes))
 		{
-			aiMesh* ai_mesh = ai_scene->mMeshes[ai_node->mMeshes[i]];
-			meshes.push_back(ProcessMesh(ai_mesh, ai_scene, directory));
+			PALMX_ERROR("Failed to read cooked model at path: " << file_path);
+			return false;
 		}
 
-		// Then do the same for each of its children
-		for (unsigned int i = 0; i < ai_node->mNumChildren; i++)
+		std::vector<const model_import::MeshInfo*> infos;
+		for (const model_import::MeshView& mesh : meshes)
+			infos.push_back(&mesh.info);
+		std::vector<Texture> preloaded = PreloadMaterialTextures(infos, directory);
+
+		for (const model_import::MeshView& mesh : meshes)
 		{
-			std::vector<Mesh> child_meshes = ProcessNode(ai_node->mChildren[i], ai_scene, directory);
-			meshes.insert(meshes.end(), child_meshes.begin(), child_meshes.end());
+			if (mesh.info.format != format)
+				PALMX_WARN("Cooked model " << file_path << " was cooked in vertex format " << static_cast<int>(mesh.info.format) << " instead of " << static_cast<int>(format));
+
+			model.meshes.push_back(CreateMesh(mesh.info, mesh.vertices, mesh.vertices_size, mesh.indices, mesh.indices_size, directory));
 		}
 
-		return meshes;
+		// The meshes hold their own references now
+		for (const Texture& texture : preloaded)
+			UnloadTexture(texture);
+
+		return true;
 	}
 
-	Model LoadModel(const std::string& file_path)
+	Model LoadModel(const std::string& file_path, VertexFormat format)
 	{
+		PALMX_PROFILE_SCOPE("LoadModel");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		unsigned int flags =
-			aiProcess_CalcTangentSpace | // calculate tangents and bitangents if possible
-			aiProcess_JoinIdenticalVertices | // join identical vertices/ optimize indexing
-			//aiProcess_ValidateDataStructure  | // perform a full validation of the loader's output
-			aiProcess_Triangulate | // Ensure all verticies are triangulated (each 3 vertices are triangle)
-			//aiProcess_ConvertToLeftHanded | // convert everything to D3D left handed space (by default right-handed, for OpenGL)
-			aiProcess_SortByPType | // ?
-			aiProcess_ImproveCacheLocality | // improve the cache locality of the output vertices
-			aiProcess_RemoveRedundantMaterials | // remove redundant materials
-			aiProcess_FindDegenerates | // remove degenerated polygons from the import
-			aiProcess_FindInvalidData | // detect invalid model data, such as invalid normal vectors
-			aiProcess_GenUVCoords | // convert spherical, cylindrical, box and planar mapping to proper UVs
-			aiProcess_TransformUVCoords | // preprocess UV transformations (scaling, translation ...)
-			aiProcess_FindInstances | // search for instanced meshes and remove them by references to one master
-			aiProcess_LimitBoneWeights | // limit bone weights to 4 per vertex
-			aiProcess_OptimizeMeshes | // join small meshes, if possible;
-			//aiProcess_PreTransformVertices | //-- fixes the transformation issue.
-			//aiProcess_SplitByBoneCount | // split meshes with too many bones. Necessary for our (limited) hardware skinning shader
-			aiProcess_FlipUVs | // flip all UVs or else textures will be messed up
-			0;
-
-		Assimp::Importer importer;
-		const aiScene* ai_scene = importer.ReadFile(file_path, flags);
-
-		if (!ai_scene || ai_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !ai_scene->mRootNode)
-		{
-			auto error = importer.GetErrorString();
-			PALMX_ERROR("Failed to load model with Assimp\n" << error);
-			return Model();
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { return LoadModel(file_path, format); });
+
+		// The same file can be loaded in different vertex formats, each one is cached separately
+		std::string cache_key = file_path + "#" + std::to_string(format);
+		auto it = model_cache.find(cache_key);
+		if (it != model_cache.end())
+		{
+			it->second.references++;
+
+			Model model;
+			model.meshes = it->second.meshes;
+			return model;
 		}
 
+		std::string directory = std::string(file_path).substr(0, std::string(file_path).find_last_of('/'));
+
 		Model model;
-		model.meshes = ProcessNode(ai_scene->mRootNode, ai_scene, std::string(file_path).substr(0, std::string(file_path).find_last_of('/')));
+		std::string cooked_path = FindCookedFile(file_path, ".pxmesh");
+		if (!cooked_path.empty())
+		{
+			if (!LoadCookedModel(cooked_path, format, directory, model))
+				return Model();
+		}
+		else
+		{
+#ifdef PALMX_USE_ASSIMP
+			std::vector<model_import::MeshData> meshes;
+			if (!model_import::ImportModel(file_path, format, meshes))
+				return Model();
+
+			std::vector<const model_import::MeshInfo*> infos;
+			for (const model_import::MeshData& mesh : meshes)
+				infos.push_back(&mesh.info);
+			std::vector<Texture> preloaded = PreloadMaterialTextures(infos, directory);
+
+			// Only the uploads are serialized on the context thread
+			for (const model_import::MeshData& mesh : meshes)
+			{
+				model.meshes.push_back(CreateMesh(mesh.info, mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), directory));
+			}
+
+			for (const Texture& texture : preloaded)
+				UnloadTexture(texture);
+#else
+			PALMX_ERROR("No cooked model found for " << file_path << ", run palmx_mesh_cooker on it or build with PALMX_USE_ASSIMP");
+			return Model();
+#endif
+		}
+
+		if (!model.meshes.empty())
+		{
+			model_cache[cache_key] = { model.meshes, 1 };
+			model_cache_keys[model.meshes[0].vao] = cache_key;
+		}
+
 		return model;
 	}
 
-	void DrawModel(Model& model)
+	void UnloadModel(const Model& model)
 	{
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		glUseProgram(model_shader.id);
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { UnloadModel(model); });
+
+		if (model.meshes.empty())
+			return;
+
+		// Every mesh has its own vertex array, so the first one identifies the cached model
+		auto key = model_cache_keys.find(model.meshes[0].vao);
+		if (key == model_cache_keys.end())
+			return;
+
+		auto it = model_cache.find(key->second);
+		if (--it->second.references > 0)
+			return;
 
-		for (Mesh& mesh : model.meshes)
+		for (const Mesh& mesh : it->second.meshes)
 		{
-			glUniformMatrix4fv(glGetUniformLocation(model_shader.id, "u_Model"), 1, GL_FALSE, glm::value_ptr(model.transform.GetTransform()));
-			glUniform3fv(glGetUniformLocation(model_shader.id, "u_ModelPosition"), 3, glm::value_ptr(model.transform.position));
+			DeleteAfterFrame(GlObjectType::VertexArray, mesh.vao);
+			DeleteAfterFrame(GlObjectType::Buffer, mesh.vbo);
+			DeleteAfterFrame(GlObjectType::Buffer, mesh.ebo);
 
-			glActiveTexture(GL_TEXTURE0 + 0);
-			// Set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(model_shader.id, "u_TextureAlbedo"), 0);
-			// Bind the texture
-			glBindTexture(GL_TEXTURE_2D, mesh.albedo_texture.id);
+			UnloadTexture(mesh.albedo_texture);
+			UnloadTexture(mesh.normal_texture);
+		}
 
-			glActiveTexture(GL_TEXTURE0 + 1);
-			// Set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(model_shader.id, "u_TextureNormal"), 1);
-			// Bind the texture
-			glBindTexture(GL_TEXTURE_2D, mesh.normal_texture.id);
+		model_cache.erase(it);
+		model_cache_keys.erase(key);
+	}
 
-			// Draw mesh
-			glBindVertexArray(mesh.vao);
-			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(mesh.indices.size()), GL_UNSIGNED_INT, 0);
-			glBindVertexArray(0);
+	BoundingBox GetModelBoundingBox(const Model& model)
+	{
+		if (model.meshes.empty())
+			return BoundingBox();
 
-			// Set everything back to default
-			glActiveTexture(GL_TEXTURE0);
+		BoundingBox box = model.meshes[0].bounding_box;
+		for (const Mesh& mesh : model.meshes)
+		{
+			box.min = glm::min(box.min, mesh.bounding_box.min);
+			box.max = glm::max(box.max, mesh.bounding_box.max);
+		}
+
+		return box;
+	}
+
+	// Cheap sphere rejection first, the box is tighter for elongated meshes
+	static bool IsInFrustum(const BoundingSphere& sphere, const BoundingBox& box, const glm::mat4& transform)
+	{
+		return IsSphereInFrustum(camera_frustum, TransformBoundingSphere(sphere, transform))
+			&& IsBoxInFrustum(camera_frustum, TransformBoundingBox(box, transform));
+	}
+
+	static bool IsVisible(const BoundingSphere& sphere, const BoundingBox& box, const glm::mat4& transform)
+	{
+		bool visible = IsInFrustum(sphere, box, transform);
+
+		render_queue::CountObjects(visible ? 1 : 0, visible ? 0 : 1);
+		return visible;
+	}
+
+	// Below this many instances culling on the calling thread is faster than spreading it over the job system
+	static const size_t parallel_cull_threshold{ 1024 };
+
+	// Append the matrices of all visible instances to the list, returns the first visible instance (nullptr if none is)
+	static const Transform* CullInstances(std::span<const Transform> transforms, const BoundingSphere& sphere, const BoundingBox& box, render_queue::DrawList& list)
+	{
+		const Transform* first_visible_instance = nullptr;
+
+		if (transforms.size() < parallel_cull_threshold)
+		{
+			for (const Transform& transform : transforms)
+			{
+				glm::mat4 matrix = transform.GetTransform();
+				if (!IsVisible(sphere, box, matrix))
+					continue;
+
+				list.instance_transforms.push_back(matrix);
+				if (first_visible_instance == nullptr)
+					first_visible_instance = &transform;
+			}
+
+			return first_visible_instance;
+		}
+
+		// Test in parallel, then compact in order so the instance order does not depend on the thread timing
+		std::vector<glm::mat4> matrices(transforms.size());
+		std::vector<uint8_t> visible(transforms.size());
+		ParallelFor(transforms.size(), [&](size_t i) {
+			matrices[i] = transforms[i].GetTransform();
+			visible[i] = IsInFrustum(sphere, box, matrices[i]);
+		});
+
+		uint32_t drawn = 0;
+		for (size_t i = 0; i < transforms.size(); i++)
+		{
+			if (!visible[i])
+				continue;
+
+			list.instance_transforms.push_back(matrices[i]);
+			if (first_visible_instance == nullptr)
+				first_visible_instance = &transforms[i];
+			drawn++;
+		}
+
+		render_queue::CountObjects(drawn, static_cast<uint32_t>(transforms.size()) - drawn);
+		return first_visible_instance;
+	}
+
+	const Frustum& graphics::GetCameraFrustum()
+	{
+		return camera_frustum;
+	}
+
+	void graphics::QueueModel(const Model& model, const glm::mat4& transform, bool cull)
+	{
+		render_queue::Command command = {};
+		command.type = render_queue::CommandType::Mesh;
+		command.transform = transform;
+		command.position = glm::vec3(transform[3]);
+
+		float depth = glm::distance(camera_position, command.position) / camera_far_plane;
+
+		// The statistics count the model once, it is drawn if any of its meshes is
+		bool any_visible = false;
+		for (const Mesh& mesh : model.meshes)
+		{
+			if (cull && !IsInFrustum(mesh.bounding_sphere, mesh.bounding_box, command.transform))
+				continue;
+
+			any_visible = true;
+
+			command.vao = mesh.vao;
+			command.textures[0] = mesh.albedo_texture.id;
+			command.textures[1] = mesh.normal_texture.id;
+			command.element_count = mesh.index_count;
+			command.index_type = mesh.index_type;
+			command.position_offset = mesh.position_offset;
+			command.position_scale = mesh.position_scale;
+
+			render_queue::Push(render_queue::MakeSceneKey(model_shader.id, mesh.albedo_texture.id, mesh.vao, depth), command);
+		}
+
+		render_queue::CountObjects(any_visible ? 1 : 0, any_visible ? 0 : 1);
+	}
+
+	void DrawModel(Model& model)
+	{
+		PALMX_PROFILE_SCOPE("DrawModel");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		graphics::QueueModel(model, model.transform.GetTransform(), true);
+	}
+
+	void DrawModel(const Model& model, TransformId transform)
+	{
+		PALMX_PROFILE_SCOPE("DrawModel");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		graphics::QueueModel(model, GetWorldMatrix(transform), true);
+	}
+
+	void DrawModelInstanced(const Model& model, std::span<const Transform> transforms)
+	{
+		PALMX_PROFILE_SCOPE("DrawModelInstanced");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		if (transforms.empty())
+			return;
+
+		render_queue::Command command = {};
+		command.type = render_queue::CommandType::Mesh;
+		render_queue::DrawList& list = render_queue::GetDrawList();
+		command.data_index = static_cast<uint32_t>(list.instance_transforms.size());
+
+		// Cull whole instances against the bounds of the entire model
+		BoundingBox model_box = GetModelBoundingBox(model);
+		BoundingSphere model_sphere = { (model_box.min + model_box.max) * 0.5f, glm::distance(model_box.min, model_box.max) * 0.5f };
+
+		const Transform* first_visible_instance = CullInstances(transforms, model_sphere, model_box, list);
+
+		command.instance_count = static_cast<uint32_t>(list.instance_transforms.size()) - command.data_index;
+		if (command.instance_count == 0)
+			return;
+
+		float depth = glm::distance(camera_position, first_visible_instance->position) / camera_far_plane;
+
+		// All instances share the instance range, so every mesh is a single draw call
+		for (const Mesh& mesh : model.meshes)
+		{
+			command.vao = mesh.vao;
+			command.textures[0] = mesh.albedo_texture.id;
+			command.textures[1] = mesh.normal_texture.id;
+			command.element_count = mesh.index_count;
+			command.index_type = mesh.index_type;
+			command.position_offset = mesh.position_offset;
+			command.position_scale = mesh.position_scale;
+
+			render_queue::Push(render_queue::MakeSceneKey(model_instanced_shader.id, mesh.albedo_texture.id, mesh.vao, depth), command);
 		}
 	}
 
@@ -653,7 +1675,12 @@ namespace palmx
 	{
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { return CreateCube(); });
+
 		Primitive cube = {};
+		cube.bounding_box = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+		cube.bounding_sphere = { glm::vec3(0.0f), glm::length(glm::vec3(0.5f)) };
 
 		GLfloat vertices[] = {
 			-0.5f, -0.5f, -0.5f,
@@ -715,25 +1742,181 @@ namespace palmx
 		return cube;
 	}
 
+	void UnloadPrimitive(const Primitive& primitive)
+	{
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { UnloadPrimitive(primitive); });
+
+		DeleteAfterFrame(GlObjectType::VertexArray, primitive.vao);
+		DeleteAfterFrame(GlObjectType::Buffer, primitive.vbo);
+		if (primitive.ebo != 0)
+			DeleteAfterFrame(GlObjectType::Buffer, primitive.ebo);
+	}
+
 	// TODO: Add more primitives
 	// TODO: Support primitives with indices
+	void graphics::QueuePrimitive(const Primitive& primitive, const glm::mat4& transform, bool cull)
+	{
+		render_queue::Command command = {};
+		command.type = render_queue::CommandType::Primitive;
+		command.vao = primitive.vao;
+		command.element_count = 36;
+		command.transform = transform;
+		command.color = primitive.color;
+
+		bool visible = !cull || IsInFrustum(primitive.bounding_sphere, primitive.bounding_box, command.transform);
+		render_queue::CountObjects(visible ? 1 : 0, visible ? 0 : 1);
+		if (!visible)
+			return;
+
+		float depth = glm::distance(camera_position, glm::vec3(transform[3])) / camera_far_plane;
+		render_queue::Push(render_queue::MakeSceneKey(primitive_shader.id, 0, primitive.vao, depth), command);
+	}
+
 	void DrawPrimitive(Primitive& primitive)
 	{
+		PALMX_PROFILE_SCOPE("DrawPrimitive");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		// Only works when face culling is disabled or else some faces will be invisible
-		glDisable(GL_CULL_FACE);
+		graphics::QueuePrimitive(primitive, primitive.transform.GetTransform(), true);
+	}
 
-		glUseProgram(primitive_shader.id);
-		glUniform4f(glGetUniformLocation(primitive_shader.id, "u_Color"), primitive.color.r, primitive.color.g, primitive.color.b, primitive.color.a);
+	void DrawPrimitive(const Primitive& primitive, TransformId transform)
+	{
+		PALMX_PROFILE_SCOPE("DrawPrimitive");
 
-		glUniformMatrix4fv(glGetUniformLocation(primitive_shader.id, "u_Model"), 1, GL_FALSE, glm::value_ptr(primitive.transform.GetTransform()));
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		glBindVertexArray(primitive.vao);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
+		graphics::QueuePrimitive(primitive, GetWorldMatrix(transform), true);
+	}
 
-		// Enable it again
-		glEnable(GL_CULL_FACE);
+	void DrawPrimitiveInstanced(const Primitive& primitive, std::span<const Transform> transforms)
+	{
+		PALMX_PROFILE_SCOPE("DrawPrimitiveInstanced");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		if (transforms.empty())
+			return;
+
+		render_queue::Command command = {};
+		command.type = render_queue::CommandType::Primitive;
+		command.vao = primitive.vao;
+		command.element_count = 36;
+		command.color = primitive.color;
+		render_queue::DrawList& list = render_queue::GetDrawList();
+		command.data_index = static_cast<uint32_t>(list.instance_transforms.size());
+
+		const Transform* first_visible_instance = CullInstances(transforms, primitive.bounding_sphere, primitive.bounding_box, list);
+
+		command.instance_count = static_cast<uint32_t>(list.instance_transforms.size()) - command.data_index;
+		if (command.instance_count == 0)
+			return;
+
+		float depth = glm::distance(camera_position, first_visible_instance->position) / camera_far_plane;
+		render_queue::Push(render_queue::MakeSceneKey(primitive_instanced_shader.id, 0, primitive.vao, depth), command);
+	}
+
+	// Point the instance matrix attribute of the bound vertex array at the command's range of the instance buffer
+	static void BindInstanceAttributes(uint32_t first_instance)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, frame_instance_buffer);
+
+		for (GLuint column = 0; column < 4; column++)
+		{
+			GLuint location = instance_attribute_location + column;
+			size_t offset = frame_instance_offset + first_instance * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)offset);
+			glVertexAttribDivisor(location, 1);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// The vertex array is shared with regular draws of the same mesh, which must not source the instance range
+	static void UnbindInstanceAttributes()
+	{
+		for (GLuint column = 0; column < 4; column++)
+		{
+			GLuint location = instance_attribute_location + column;
+
+			glVertexAttribDivisor(location, 0);
+			glDisableVertexAttribArray(location);
+		}
+	}
+
+	void graphics::ExecuteCommand(const render_queue::Command& command)
+	{
+		bool instanced = command.instance_count > 0;
+
+		// The instance matrices could not be streamed this frame
+		if (instanced && !frame_instances_streamed)
+			return;
+
+		switch (command.type)
+		{
+		case render_queue::CommandType::Mesh:
+		{
+			const Shader& shader = instanced ? model_instanced_shader : model_shader;
+			render_queue::UseProgram(shader.id);
+			render_queue::SetFaceCulling(true);
+
+			// The samplers are already set to these units
+			render_queue::BindTexture(0, command.textures[0]);
+			render_queue::BindTexture(1, command.textures[1]);
+
+			render_queue::BindVertexArray(command.vao);
+
+			glUniform3fv(shader.locations[shader_location::PositionOffset], 1, glm::value_ptr(command.position_offset));
+			glUniform3fv(shader.locations[shader_location::PositionScale], 1, glm::value_ptr(command.position_scale));
+
+			if (instanced)
+			{
+				BindInstanceAttributes(command.data_index);
+				glDrawElementsInstanced(GL_TRIANGLES, command.element_count, command.index_type, 0, command.instance_count);
+				UnbindInstanceAttributes();
+			}
+			else
+			{
+				glUniformMatrix4fv(shader.locations[shader_location::Model], 1, GL_FALSE, glm::value_ptr(command.transform));
+				glUniform3fv(shader.locations[shader_location::ModelPosition], 1, glm::value_ptr(command.position));
+				glDrawElements(GL_TRIANGLES, command.element_count, command.index_type, 0);
+			}
+			render_queue::CountDrawCall();
+			break;
+		}
+		case render_queue::CommandType::Primitive:
+		{
+			const Shader& shader = instanced ? primitive_instanced_shader : primitive_shader;
+			render_queue::UseProgram(shader.id);
+			// Only works when face culling is disabled or else some faces will be invisible
+			render_queue::SetFaceCulling(false);
+
+			glUniform4f(shader.locations[shader_location::Color], command.color.r, command.color.g, command.color.b, command.color.a);
+
+			render_queue::BindVertexArray(command.vao);
+
+			if (instanced)
+			{
+				BindInstanceAttributes(command.data_index);
+				glDrawArraysInstanced(GL_TRIANGLES, 0, command.element_count, command.instance_count);
+				UnbindInstanceAttributes();
+			}
+			else
+			{
+				glUniformMatrix4fv(shader.locations[shader_location::Model], 1, GL_FALSE, glm::value_ptr(command.transform));
+				glDrawArrays(GL_TRIANGLES, 0, command.element_count);
+			}
+			render_queue::CountDrawCall();
+			break;
+		}
+		default:
+			break;
+		}
 	}
 }
\ No newline at end of file
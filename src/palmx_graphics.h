@@ -29,11 +29,26 @@
 #ifndef PALMX_GRAPHICS_H
 #define PALMX_GRAPHICS_H
 
+#include "palmx_render_queue.h"
+
+#include <palmx.h>
+#include <palmx_math.h>
+
 #include <string>
 
 namespace palmx::graphics
 {
 	extern void Init();
+	extern void ExecuteCommand(const render_queue::Command& command);
+	// Make the GL calls of the frame submitted by EndDrawing, on the render thread if it is enabled
+	extern void RenderFrame();
+	// Upload textures finished by LoadTextureAsync, limited by the texture upload budget
+	extern void UploadDecodedTextures();
+
+	extern const Frustum& GetCameraFrustum();
+	// Queue draws with an already computed world matrix, optionally testing every mesh against the frustum
+	extern void QueueModel(const Model& model, const glm::mat4& transform, bool cull);
+	extern void QueuePrimitive(const Primitive& primitive, const glm::mat4& transform, bool cull);
 }
 
 #endif // PALMX_GRAPHICS_H
\ No newline at end of file
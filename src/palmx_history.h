@@ -0,0 +1,82 @@
+/**********************************************************************************************
+*
+*   palmx - internal frame history header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+#ifndef PALMX_HISTORY_H
+#define PALMX_HISTORY_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace palmx
+{
+	// Ring buffer of the last N per-frame values, not synchronized
+	template<typename T, size_t N>
+	class History
+	{
+	public:
+		void Push(const T& value)
+		{
+			values[next] = value;
+			next = (next + 1) % N;
+			count = std::min(count + 1, N);
+		}
+
+		void Clear()
+		{
+			next = 0;
+			count = 0;
+		}
+
+		// Up to the last frame_count values, oldest first
+		std::vector<T> GetLatest(size_t frame_count) const
+		{
+			frame_count = std::min(frame_count, count);
+
+			std::vector<T> latest;
+			latest.reserve(frame_count);
+
+			// The newest value is right before next
+			size_t start = (next + N - frame_count) % N;
+			for (size_t i = 0; i < frame_count; i++)
+			{
+				latest.push_back(values[(start + i) % N]);
+			}
+
+			return latest;
+		}
+
+	private:
+		std::array<T, N> values{};
+		size_t next{ 0 };
+		size_t count{ 0 };
+	};
+}
+
+#endif // PALMX_HISTORY_H
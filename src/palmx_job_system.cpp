@@ -0,0 +1,463 @@
+/**********************************************************************************************
+*
+*   palmx - work-stealing job system
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+
+#include "pxpch.h"
+
+#include "palmx_job_system.h"
+#include "palmx_render_thread.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace palmx
+{
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+
+	// The owning worker pushes and pops at the back, so it works on its newest (cache warm) jobs.
+	// Other threads steal from the front, taking the oldest jobs which tend to be the largest.
+	struct WorkerQueue
+	{
+		std::deque<Job> jobs;
+		std::mutex mutex;
+	};
+
+	static JobConfig job_config;
+	static std::atomic<bool> running{ false };
+	static std::thread::id main_thread_id;
+
+	static std::vector<std::thread> workers;
+	static std::vector<std::unique_ptr<WorkerQueue>> worker_queues;
+	static std::atomic<uint32_t> next_worker_queue{ 0 }; // Jobs from threads that are no worker are spread round robin
+	static std::atomic<uint32_t> queued_job_count{ 0 };
+	static thread_local int worker_index{ -1 };
+
+	static std::deque<Job> main_thread_jobs;
+	static std::mutex main_thread_jobs_mutex;
+	static std::atomic<uint32_t> main_thread_job_count{ 0 };
+
+	// Idle workers and waiting threads sleep until jobs are queued or a counter reaches zero
+	static std::mutex wake_mutex;
+	static std::condition_variable wake_condition;
+	static bool stopping{ false };
+
+	static void PinCurrentThread(uint32_t core)
+	{
+#ifdef _WIN32
+		if (core < sizeof(DWORD_PTR) * 8)
+		{
+			SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core);
+		}
+#elif defined(__linux__)
+		cpu_set_t cpu_set;
+		CPU_ZERO(&cpu_set);
+		CPU_SET(core, &cpu_set);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+		(void)core;
+#endif
+	}
+
+	static void WakeAll()
+	{
+		{
+			// Taking the lock orders the notification after the state change the sleepers check
+			std::lock_guard<std::mutex> lock(wake_mutex);
+		}
+		wake_condition.notify_all();
+	}
+
+	static void FinishJob(JobCounter* counter)
+	{
+		if (counter == nullptr)
+			return;
+
+		std::vector<std::function<void()>> dependents;
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+			if (--counter->count > 0)
+				return;
+
+			dependents.swap(counter->dependents);
+		}
+
+		// The counter may be gone from here on, a waiter can return as soon as it sees zero
+		for (std::function<void()>& dependent : dependents)
+		{
+			dependent();
+		}
+
+		WakeAll();
+	}
+
+	static void Execute(Job& job)
+	{
+		job.function();
+		FinishJob(job.counter);
+	}
+
+	// The job is already counted on its counter
+	static void Schedule(Job job, JobAffinity affinity)
+	{
+		if (!running)
+		{
+			Execute(job);
+			return;
+		}
+
+		if (affinity == job_affinity::MainThread)
+		{
+			{
+				std::lock_guard<std::mutex> lock(main_thread_jobs_mutex);
+				main_thread_jobs.push_back(std::move(job));
+			}
+			main_thread_job_count++;
+
+			// Only the main thread can run it, so a single notification could wake the wrong thread
+			WakeAll();
+			return;
+		}
+
+		uint32_t queue_index = worker_index >= 0 ? static_cast<uint32_t>(worker_index) : next_worker_queue++ % worker_queues.size();
+		WorkerQueue& queue = *worker_queues[queue_index];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+		queued_job_count++;
+
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+		}
+		wake_condition.notify_one();
+	}
+
+	static bool TryPopJob(Job& job)
+	{
+		if (queued_job_count == 0)
+			return false;
+
+		size_t queue_count = worker_queues.size();
+
+		if (worker_index >= 0)
+		{
+			WorkerQueue& own_queue = *worker_queues[worker_index];
+			std::lock_guard<std::mutex> lock(own_queue.mutex);
+			if (!own_queue.jobs.empty())
+			{
+				job = std::move(own_queue.jobs.back());
+				own_queue.jobs.pop_back();
+				queued_job_count--;
+				return true;
+			}
+		}
+
+		// Steal, starting at the next worker so thieves spread over the queues
+		size_t start = worker_index >= 0 ? worker_index + 1 : 0;
+		for (size_t i = 0; i < queue_count; i++)
+		{
+			WorkerQueue& queue = *worker_queues[(start + i) % queue_count];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.jobs.empty())
+			{
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+				queued_job_count--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// With a render thread the GL context lives there, main thread jobs run on it while the main thread waits
+	static void ExecuteMainThreadJobs(std::deque<Job>& jobs)
+	{
+		render_thread::Run([&jobs]() {
+			for (Job& job : jobs)
+			{
+				Execute(job);
+			}
+		});
+	}
+
+	static bool TryPopMainThreadJob(Job& job)
+	{
+		if (main_thread_job_count == 0)
+			return false;
+
+		std::lock_guard<std::mutex> lock(main_thread_jobs_mutex);
+		if (main_thread_jobs.empty())
+			return false;
+
+		job = std::move(main_thread_jobs.front());
+		main_thread_jobs.pop_front();
+		main_thread_job_count--;
+		return true;
+	}
+
+	static void WorkerLoop(int index, uint32_t core)
+	{
+		worker_index = index;
+
+		if (job_config.pin_threads)
+		{
+			PinCurrentThread(core);
+		}
+
+		while (true)
+		{
+			Job job;
+			if (TryPopJob(job))
+			{
+				Execute(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake_condition.wait(lock, [] { return stopping || queued_job_count > 0; });
+
+			// Queued jobs are finished before the worker exits
+			if (stopping && queued_job_count == 0)
+				return;
+		}
+	}
+
+	void job_system::Init()
+	{
+		PALMX_ASSERT(!running, "The job system cannot be started twice");
+
+		main_thread_id = std::this_thread::get_id();
+
+		// hardware_concurrency may report 0 if it cannot be determined
+		unsigned int hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		uint32_t worker_count = job_config.worker_count;
+		if (worker_count == 0)
+		{
+			worker_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+		}
+
+		if (job_config.pin_threads)
+		{
+			PinCurrentThread(0);
+		}
+
+		stopping = false;
+		worker_queues.clear();
+		for (uint32_t i = 0; i < worker_count; i++)
+		{
+			worker_queues.push_back(std::make_unique<WorkerQueue>());
+		}
+
+		// Queues have to exist before anything can be scheduled on them
+		running = true;
+		for (uint32_t i = 0; i < worker_count; i++)
+		{
+			workers.emplace_back(WorkerLoop, static_cast<int>(i), (i + 1) % hardware_threads);
+		}
+
+		PALMX_INFO("Started " << worker_count << " job workers" << (job_config.pin_threads ? " pinned to cores" : ""));
+	}
+
+	void job_system::Shutdown()
+	{
+		if (!running)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+			stopping = true;
+		}
+		wake_condition.notify_all();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		workers.clear();
+		running = false;
+
+		// Main thread jobs that never got their frame still run, anything they queue now runs right away
+		RunMainThreadJobs();
+		worker_queues.clear();
+	}
+
+	void job_system::RunMainThreadJobs()
+	{
+		PALMX_PROFILE_SCOPE("RunMainThreadJobs");
+
+		std::deque<Job> jobs;
+		{
+			std::lock_guard<std::mutex> lock(main_thread_jobs_mutex);
+			jobs.swap(main_thread_jobs);
+			main_thread_job_count -= static_cast<uint32_t>(jobs.size());
+		}
+
+		if (!jobs.empty())
+		{
+			ExecuteMainThreadJobs(jobs);
+		}
+	}
+
+	void SetJobConfig(const JobConfig& config)
+	{
+		PALMX_ASSERT(!running, "SetJobConfig has to be called before Init");
+
+		job_config = config;
+	}
+
+	uint32_t GetJobWorkerCount()
+	{
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	bool IsMainThread()
+	{
+		return std::this_thread::get_id() == main_thread_id;
+	}
+
+	void RunJob(std::function<void()> job, JobCounter* counter, JobAffinity affinity)
+	{
+		if (counter != nullptr)
+		{
+			counter->count++;
+		}
+
+		Schedule({ std::move(job), counter }, affinity);
+	}
+
+	void RunJobAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter, JobAffinity affinity)
+	{
+		if (counter != nullptr)
+		{
+			counter->count++;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+			if (dependency.count > 0)
+			{
+				dependency.dependents.push_back([job = std::move(job), counter, affinity]() mutable {
+					Schedule({ std::move(job), counter }, affinity);
+				});
+				return;
+			}
+		}
+
+		Schedule({ std::move(job), counter }, affinity);
+	}
+
+	void WaitForCounter(JobCounter& counter)
+	{
+		PALMX_PROFILE_SCOPE("WaitForCounter");
+
+		bool main_thread = IsMainThread();
+
+		while (counter.count > 0)
+		{
+			Job job;
+			if (main_thread && TryPopMainThreadJob(job))
+			{
+				std::deque<Job> jobs;
+				jobs.push_back(std::move(job));
+				ExecuteMainThreadJobs(jobs);
+				continue;
+			}
+
+			if (TryPopJob(job))
+			{
+				Execute(job);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake_condition.wait(lock, [&counter, main_thread] {
+				return counter.count == 0 || queued_job_count > 0 || (main_thread && main_thread_job_count > 0);
+			});
+		}
+
+		// The last job may still be releasing the counter's mutex after setting it to zero
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	void ParallelFor(size_t count, const std::function<void(size_t)>& function)
+	{
+		if (count == 0)
+			return;
+
+		// A few batches per thread balance uneven work without paying for a job per index
+		size_t batch_count = std::min(count, (workers.size() + 1) * 4);
+		size_t batch_size = (count + batch_count - 1) / batch_count;
+
+		if (!running || batch_count == 1)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				function(i);
+			}
+			return;
+		}
+
+		JobCounter counter;
+		for (size_t begin = batch_size; begin < count; begin += batch_size)
+		{
+			size_t end = std::min(begin + batch_size, count);
+			RunJob([&function, begin, end]() {
+				for (size_t i = begin; i < end; i++)
+				{
+					function(i);
+				}
+			}, &counter);
+		}
+
+		// The calling thread takes the first batch, then helps with the rest
+		for (size_t i = 0; i < batch_size; i++)
+		{
+			function(i);
+		}
+
+		WaitForCounter(counter);
+	}
+}
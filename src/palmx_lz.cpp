@@ -0,0 +1,189 @@
+/**********************************************************************************************
+*
+*   palmx - byte oriented LZ77 compression for pack files
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "palmx_lz.h"
+
+#include <cstring>
+
+namespace palmx
+{
+	static const size_t min_match = 4;
+	static const size_t max_offset = 65535;
+	static const int hash_bits = 16;
+
+	static uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - hash_bits);
+	}
+
+	static void WriteLength(std::vector<uint8_t>& compressed, size_t length)
+	{
+		while (length >= 255)
+		{
+			compressed.push_back(255);
+			length -= 255;
+		}
+		compressed.push_back(static_cast<uint8_t>(length));
+	}
+
+	static void WriteBlock(std::vector<uint8_t>& compressed, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length)
+	{
+		size_t match_code = match_length > 0 ? match_length - min_match : 0;
+
+		uint8_t token = static_cast<uint8_t>((literal_length < 15 ? literal_length : 15) << 4);
+		token |= static_cast<uint8_t>(match_code < 15 ? match_code : 15);
+		compressed.push_back(token);
+
+		if (literal_length >= 15)
+			WriteLength(compressed, literal_length - 15);
+		compressed.insert(compressed.end(), literals, literals + literal_length);
+
+		if (match_length == 0)
+			return;
+
+		compressed.push_back(static_cast<uint8_t>(offset & 0xFF));
+		compressed.push_back(static_cast<uint8_t>(offset >> 8));
+		if (match_code >= 15)
+			WriteLength(compressed, match_code - 15);
+	}
+
+	void lz::Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& compressed)
+	{
+		compressed.clear();
+		compressed.reserve(size + size / 255 + 16);
+
+		// Most recent position of every hashed 4 byte sequence
+		std::vector<int64_t> table(size_t(1) << hash_bits, -1);
+
+		size_t anchor = 0;
+		size_t position = 0;
+		while (position + min_match <= size)
+		{
+			uint32_t sequence = Read32(data + position);
+			uint32_t hash = Hash(sequence);
+			int64_t candidate = table[hash];
+			table[hash] = static_cast<int64_t>(position);
+
+			if (candidate < 0 || position - candidate > max_offset || Read32(data + candidate) != sequence)
+			{
+				position++;
+				continue;
+			}
+
+			size_t match_length = min_match;
+			while (position + match_length < size && data[candidate + match_length] == data[position + match_length])
+				match_length++;
+
+			WriteBlock(compressed, data + anchor, position - anchor, position - candidate, match_length);
+
+			position += match_length;
+			anchor = position;
+		}
+
+		WriteBlock(compressed, data + anchor, size - anchor, 0, 0);
+	}
+
+	static bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+	{
+		uint8_t value;
+		do
+		{
+			if (in == end)
+				return false;
+			value = *in++;
+			length += value;
+		} while (value == 255);
+
+		return true;
+	}
+
+	bool lz::Decompress(const uint8_t* compressed, size_t compressed_size, uint8_t* data, size_t size)
+	{
+		const uint8_t* in = compressed;
+		const uint8_t* in_end = compressed + compressed_size;
+		size_t out = 0;
+
+		while (in < in_end)
+		{
+			uint8_t token = *in++;
+
+			size_t literal_length = token >> 4;
+			if (literal_length == 15 && !ReadLength(in, in_end, literal_length))
+				return false;
+
+			if (literal_length > static_cast<size_t>(in_end - in) || literal_length > size - out)
+				return false;
+
+			if (literal_length > 0)
+				std::memcpy(data + out, in, literal_length);
+			in += literal_length;
+			out += literal_length;
+
+			// The last block has no match
+			if (in == in_end)
+				break;
+
+			if (in_end - in < 2)
+				return false;
+
+			size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+			in += 2;
+
+			size_t match_length = token & 0x0F;
+			if (match_length == 15 && !ReadLength(in, in_end, match_length))
+				return false;
+			match_length += min_match;
+
+			if (offset == 0 || offset > out || match_length > size - out)
+				return false;
+
+			// Matches may overlap their own output, which repeats the last offset bytes
+			const uint8_t* match = data + out - offset;
+			if (offset >= match_length)
+			{
+				std::memcpy(data + out, match, match_length);
+			}
+			else
+			{
+				for (size_t i = 0; i < match_length; i++)
+					data[out + i] = match[i];
+			}
+			out += match_length;
+		}
+
+		return out == size;
+	}
+}
@@ -0,0 +1,54 @@
+/**********************************************************************************************
+*
+*   palmx - internal LZ compression header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_LZ_H
+#define PALMX_LZ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte oriented LZ77 in the style of LZ4. Decompression is a tight copy loop without
+// entropy decoding, so unpacking is bound by memory bandwidth rather than by the CPU.
+//
+// The stream is a sequence of blocks:
+//   token          High nibble literal length, low nibble match length - 4 (15 = more bytes follow)
+//   [length bytes] Literal length continuation, 255 adds 255 and continues
+//   literals
+//   offset         2 bytes little endian, distance back into the output
+//   [length bytes] Match length continuation
+// The last block only contains literals and ends with the input.
+namespace palmx::lz
+{
+	extern void Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& compressed);
+	// Returns false if the data is corrupt or does not decompress to exactly size bytes
+	extern bool Decompress(const uint8_t* compressed, size_t compressed_size, uint8_t* data, size_t size);
+}
+
+#endif // PALMX_LZ_H
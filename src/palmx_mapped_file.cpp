@@ -0,0 +1,143 @@
+/**********************************************************************************************
+*
+*   palmx - memory mapped files
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include "palmx_mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace palmx
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string& file_path)
+	{
+		Close();
+
+		HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		file_handle = file;
+		mapping_handle = mapping;
+		data = static_cast<const uint8_t*>(view);
+		size = static_cast<size_t>(file_size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		if (mapping_handle != nullptr)
+			CloseHandle(mapping_handle);
+		if (file_handle != nullptr)
+			CloseHandle(file_handle);
+
+		data = nullptr;
+		size = 0;
+		file_handle = nullptr;
+		mapping_handle = nullptr;
+	}
+#else
+	bool MappedFile::Open(const std::string& file_path)
+	{
+		Close();
+
+		int file = open(file_path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat file_stat;
+		if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+
+		void* view = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping keeps its own reference to the file
+		close(file);
+		if (view == MAP_FAILED)
+			return false;
+
+		// Assets are read front to back once, let the kernel read ahead aggressively
+		madvise(view, file_stat.st_size, MADV_SEQUENTIAL);
+
+		data = static_cast<const uint8_t*>(view);
+		size = static_cast<size_t>(file_stat.st_size);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (data != nullptr)
+			munmap(const_cast<uint8_t*>(data), size);
+
+		data = nullptr;
+		size = 0;
+	}
+#endif
+}
@@ -51,4 +51,82 @@ namespace palmx
     {
         return glm::normalize(glm::cross(Vector3Right(vec3), Vector3Forward(vec3)));
     }
+
+    Frustum ExtractFrustum(const glm::mat4& view_projection)
+    {
+        // Gribb/Hartmann: every plane is the sum or difference of the fourth row and one of the others
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+        {
+            rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+        }
+
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[3] + rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+
+        for (glm::vec4& plane : frustum.planes)
+        {
+            plane = plane / glm::length(glm::vec3(plane));
+        }
+
+        return frustum;
+    }
+
+    bool IsSphereInFrustum(const Frustum& frustum, const BoundingSphere& sphere)
+    {
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool IsBoxInFrustum(const Frustum& frustum, const BoundingBox& box)
+    {
+        for (const glm::vec4& plane : frustum.planes)
+        {
+            // Test the corner furthest along the plane normal, if it is outside the whole box is
+            glm::vec3 corner(
+                plane.x >= 0.0f ? box.max.x : box.min.x,
+                plane.y >= 0.0f ? box.max.y : box.min.y,
+                plane.z >= 0.0f ? box.max.z : box.min.z
+            );
+
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+
+    BoundingBox TransformBoundingBox(const BoundingBox& box, const glm::mat4& transform)
+    {
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+        glm::vec3 transformed_center = glm::vec3(transform * glm::vec4(center, 1.0f));
+
+        // Project the extents onto the absolute axes of the transform (Arvo)
+        glm::vec3 transformed_extents(0.0f);
+        for (int column = 0; column < 3; column++)
+        {
+            transformed_extents += glm::abs(glm::vec3(transform[column])) * extents[column];
+        }
+
+        return { transformed_center - transformed_extents, transformed_center + transformed_extents };
+    }
+
+    BoundingSphere TransformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& transform)
+    {
+        float max_scale = glm::max(glm::length(glm::vec3(transform[0])), glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+        return { glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * max_scale };
+    }
 }
\ No newline at end of file
@@ -0,0 +1,535 @@
+/**********************************************************************************************
+*
+*   palmx - model import through Assimp and cooked mesh files
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include "palmx_model_import.h"
+#include "palmx_asset_formats.h"
+#include "palmx_vfs.h"
+#include "palmx_job_system.h"
+
+#ifdef PALMX_USE_ASSIMP
+#include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace palmx
+{
+	size_t model_import::GetVertexSize(VertexFormat format)
+	{
+		switch (format)
+		{
+		case vertex_format::Standard:
+			return sizeof(Vertex);
+		case vertex_format::Static:
+			return sizeof(StaticVertex);
+		case vertex_format::Compact:
+			return sizeof(CompactVertex);
+		default:
+			return 0;
+		}
+	}
+
+#ifdef PALMX_USE_ASSIMP
+	// Map a unit vector onto the octahedron and unfold it into the [-1, 1] square
+	static glm::vec2 EncodeOctahedral(glm::vec3 normal)
+	{
+		normal /= (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+
+		glm::vec2 encoded(normal.x, normal.y);
+		if (normal.z < 0.0f)
+		{
+			encoded.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+			encoded.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		return encoded;
+	}
+
+	static CompactVertex MakeCompactVertex(const Vertex& vertex, const model_import::MeshInfo& info)
+	{
+		CompactVertex compact = {};
+
+		glm::vec3 normalized = (vertex.position - info.position_offset) / info.position_scale;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			compact.position[axis] = static_cast<int16_t>(std::round(glm::clamp(normalized[axis], -1.0f, 1.0f) * 32767.0f));
+		}
+
+		compact.normal = glm::packSnorm2x16(EncodeOctahedral(vertex.normal));
+		compact.tex_coords = glm::packHalf2x16(vertex.tex_coords);
+
+		return compact;
+	}
+
+	template<typename T>
+	static void AppendBytes(std::vector<uint8_t>& bytes, const std::vector<T>& values)
+	{
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(values.data());
+		bytes.insert(bytes.end(), data, data + values.size() * sizeof(T));
+	}
+
+	// Convert the vertices into the requested layout
+	static void EncodeVertices(const std::vector<Vertex>& vertices, model_import::MeshData& mesh)
+	{
+		switch (mesh.info.format)
+		{
+		case vertex_format::Standard:
+		{
+			AppendBytes(mesh.vertices, vertices);
+			break;
+		}
+		case vertex_format::Static:
+		{
+			std::vector<StaticVertex> static_vertices(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				static_vertices[i] = { vertices[i].position, vertices[i].normal, vertices[i].tex_coords, vertices[i].tangent, vertices[i].bitangent };
+			}
+
+			AppendBytes(mesh.vertices, static_vertices);
+			break;
+		}
+		case vertex_format::Compact:
+		{
+			std::vector<CompactVertex> compact_vertices(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				compact_vertices[i] = MakeCompactVertex(vertices[i], mesh.info);
+			}
+
+			AppendBytes(mesh.vertices, compact_vertices);
+			break;
+		}
+		default:
+			PALMX_ERROR("Unknown vertex format " << static_cast<int>(mesh.info.format));
+			break;
+		}
+	}
+
+	// Read-only stream over a file from the virtual filesystem
+	struct VfsIOStream : public Assimp::IOStream
+	{
+		vfs::File file;
+		size_t position{ 0 };
+
+		size_t Read(void* buffer, size_t size, size_t count) override
+		{
+			if (size == 0)
+				return 0;
+
+			size_t read_count = std::min(count, (file.size - position) / size);
+			std::memcpy(buffer, file.data + position, read_count * size);
+			position += read_count * size;
+			return read_count;
+		}
+
+		size_t Write(const void*, size_t, size_t) override
+		{
+			return 0;
+		}
+
+		aiReturn Seek(size_t offset, aiOrigin origin) override
+		{
+			size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? position : file.size;
+			if (offset > file.size - base)
+				return aiReturn_FAILURE;
+
+			position = base + offset;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t Tell() const override
+		{
+			return position;
+		}
+
+		size_t FileSize() const override
+		{
+			return file.size;
+		}
+
+		void Flush() override
+		{
+		}
+	};
+
+	// Lets Assimp resolve the model and the files it references (e.g. .mtl) through mounted packs
+	struct VfsIOSystem : public Assimp::IOSystem
+	{
+		bool Exists(const char* file_path) const override
+		{
+			return vfs::Exists(file_path);
+		}
+
+		char getOsSeparator() const override
+		{
+			return '/';
+		}
+
+		Assimp::IOStream* Open(const char* file_path, const char* mode) override
+		{
+			// Packs are read-only
+			if (std::strchr(mode, 'w') != nullptr || std::strchr(mode, 'a') != nullptr)
+				return nullptr;
+
+			VfsIOStream* stream = new VfsIOStream();
+			if (!vfs::ReadFile(file_path, stream->file))
+			{
+				delete stream;
+				return nullptr;
+			}
+
+			return stream;
+		}
+
+		void Close(Assimp::IOStream* stream) override
+		{
+			delete stream;
+		}
+	};
+
+	static model_import::MeshData ProcessMesh(aiMesh* ai_mesh, const aiScene* ai_scene, VertexFormat format)
+	{
+		PALMX_PROFILE_SCOPE("ProcessMesh");
+
+		model_import::MeshData mesh;
+		mesh.info.format = format;
+
+		std::vector<Vertex> vertices;
+		vertices.reserve(ai_mesh->mNumVertices);
+
+		for (unsigned int i = 0; i < ai_mesh->mNumVertices; i++)
+		{
+			Vertex vertex = {};
+
+			// Process vertex positions, normals and texture coordinates
+			glm::vec3 vec3;
+			vec3.x = ai_mesh->mVertices[i].x;
+			vec3.y = ai_mesh->mVertices[i].y;
+			vec3.z = ai_mesh->mVertices[i].z;
+			vertex.position = vec3;
+
+			vec3.x = ai_mesh->mNormals[i].x;
+			vec3.y = ai_mesh->mNormals[i].y;
+			vec3.z = ai_mesh->mNormals[i].z;
+			vertex.normal = vec3;
+
+			if (ai_mesh->mTextureCoords[0]) // Does the ai_mesh contain texture coordinates?
+			{
+				glm::vec2 vec2;
+				vec2.x = ai_mesh->mTextureCoords[0][i].x;
+				vec2.y = ai_mesh->mTextureCoords[0][i].y;
+				vertex.tex_coords = vec2;
+			}
+			else
+			{
+				vertex.tex_coords = glm::vec2(0.0f, 0.0f);
+			}
+
+			if (ai_mesh->mTangents && ai_mesh->mBitangents) // Only present if the tangent space could be calculated
+			{
+				vertex.tangent = glm::vec3(ai_mesh->mTangents[i].x, ai_mesh->mTangents[i].y, ai_mesh->mTangents[i].z);
+				vertex.bitangent = glm::vec3(ai_mesh->mBitangents[i].x, ai_mesh->mBitangents[i].y, ai_mesh->mBitangents[i].z);
+			}
+
+			vertices.push_back(vertex);
+		}
+
+		// Compute the bounds used for frustum culling and position quantization
+		if (!vertices.empty())
+		{
+			mesh.info.bounding_box = { vertices[0].position, vertices[0].position };
+			for (const Vertex& vertex : vertices)
+			{
+				mesh.info.bounding_box.min = glm::min(mesh.info.bounding_box.min, vertex.position);
+				mesh.info.bounding_box.max = glm::max(mesh.info.bounding_box.max, vertex.position);
+			}
+
+			mesh.info.bounding_sphere.center = (mesh.info.bounding_box.min + mesh.info.bounding_box.max) * 0.5f;
+			for (const Vertex& vertex : vertices)
+			{
+				mesh.info.bounding_sphere.radius = glm::max(mesh.info.bounding_sphere.radius, glm::distance(mesh.info.bounding_sphere.center, vertex.position));
+			}
+		}
+
+		if (format == vertex_format::Compact)
+		{
+			// Flat axes still need a non-zero scale to avoid dividing by zero
+			mesh.info.position_offset = mesh.info.bounding_sphere.center;
+			mesh.info.position_scale = glm::max((mesh.info.bounding_box.max - mesh.info.bounding_box.min) * 0.5f, glm::vec3(1e-6f));
+		}
+
+		// Process indices
+		std::vector<unsigned int> indices;
+		indices.reserve(static_cast<size_t>(ai_mesh->mNumFaces) * 3);
+		for (unsigned int i = 0; i < ai_mesh->mNumFaces; i++)
+		{
+			aiFace face = ai_mesh->mFaces[i];
+			for (unsigned int j = 0; j < face.mNumIndices; j++)
+				indices.push_back(face.mIndices[j]);
+		}
+
+		mesh.info.vertex_count = static_cast<uint32_t>(vertices.size());
+		mesh.info.index_count = static_cast<uint32_t>(indices.size());
+		mesh.info.material_name = ai_scene->mMaterials[ai_mesh->mMaterialIndex]->GetName().C_Str();
+
+		EncodeVertices(vertices, mesh);
+
+		if (mesh.info.vertex_count <= std::numeric_limits<uint16_t>::max() + 1)
+		{
+			// Every index fits into 16 bits, which halves the index buffer
+			std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+			AppendBytes(mesh.indices, short_indices);
+			mesh.info.index_size = sizeof(uint16_t);
+		}
+		else
+		{
+			AppendBytes(mesh.indices, indices);
+			mesh.info.index_size = sizeof(unsigned int);
+		}
+
+		return mesh;
+	}
+
+	// Collect the meshes in node order, the conversion itself happens in parallel afterwards
+	static void ProcessNode(aiNode* ai_node, const aiScene* ai_scene, std::vector<aiMesh*>& ai_meshes)
+	{
+		// Process all the ai_node's meshes (if any)
+		for (unsigned int i = 0; i < ai_node->mNumMeshes; i++)
+		{
+			ai_meshes.push_back(ai_scene->mMeshes[ai_node->mMeshes[i]]);
+		}
+
+		// Then do the same for each of its children
+		for (unsigned int i = 0; i < ai_node->mNumChildren; i++)
+		{
+			ProcessNode(ai_node->mChildren[i], ai_scene, ai_meshes);
+		}
+	}
+
+	bool model_import::ImportModel(const std::string& file_path, VertexFormat format, std::vector<MeshData>& meshes)
+	{
+		PALMX_PROFILE_SCOPE("ImportModel");
+
+		unsigned int flags =
+			aiProcess_CalcTangentSpace | // calculate tangents and bitangents if possible
+			aiProcess_JoinIdenticalVertices | // join identical vertices/ optimize indexing
+			//aiProcess_ValidateDataStructure  | // perform a full validation of the loader's output
+			aiProcess_Triangulate | // Ensure all verticies are triangulated (each 3 vertices are triangle)
+			//aiProcess_ConvertToLeftHanded | // convert everything to D3D left handed space (by default right-handed, for OpenGL)
+			aiProcess_SortByPType | // ?
+			aiProcess_ImproveCacheLocality | // improve the cache locality of the output vertices
+			aiProcess_RemoveRedundantMaterials | // remove redundant materials
+			aiProcess_FindDegenerates | // remove degenerated polygons from the import
+			aiProcess_FindInvalidData | // detect invalid model data, such as invalid normal vectors
+			aiProcess_GenUVCoords | // convert spherical, cylindrical, box and planar mapping to proper UVs
+			aiProcess_TransformUVCoords | // preprocess UV transformations (scaling, translation ...)
+			aiProcess_FindInstances | // search for instanced meshes and remove them by references to one master
+			aiProcess_LimitBoneWeights | // limit bone weights to 4 per vertex
+			aiProcess_OptimizeMeshes | // join small meshes, if possible;
+			//aiProcess_PreTransformVertices | //-- fixes the transformation issue.
+			//aiProcess_SplitByBoneCount | // split meshes with too many bones. Necessary for our (limited) hardware skinning shader
+			aiProcess_FlipUVs | // flip all UVs or else textures will be messed up
+			0;
+
+		Assimp::Importer importer;
+		// The importer takes ownership of the IO handler
+		importer.SetIOHandler(new VfsIOSystem());
+		const aiScene* ai_scene = importer.ReadFile(file_path, flags);
+
+		if (!ai_scene || ai_scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !ai_scene->mRootNode)
+		{
+			auto error = importer.GetErrorString();
+			PALMX_ERROR("Failed to load model with Assimp\n" << error);
+			return false;
+		}
+
+		std::vector<aiMesh*> ai_meshes;
+		ProcessNode(ai_scene->mRootNode, ai_scene, ai_meshes);
+
+		// The scene is only read, so every mesh can be converted on its own thread straight into its slot
+		size_t first_mesh = meshes.size();
+		meshes.resize(first_mesh + ai_meshes.size());
+		ParallelFor(ai_meshes.size(), [&](size_t i) {
+			meshes[first_mesh + i] = ProcessMesh(ai_meshes[i], ai_scene, format);
+		});
+
+		return true;
+	}
+#endif
+
+	bool model_import::ReadCookedModel(const uint8_t* data, size_t size, std::vector<MeshView>& meshes)
+	{
+		asset_format::MeshHeader header;
+		if (size < sizeof(header))
+		{
+			PALMX_ERROR("Cooked model is truncated");
+			return false;
+		}
+
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, asset_format::mesh_magic, sizeof(header.magic)) != 0 || header.version != asset_format::mesh_version)
+		{
+			PALMX_ERROR("Cooked model has an unknown format or version");
+			return false;
+		}
+
+		if (sizeof(header) + static_cast<uint64_t>(header.mesh_count) * sizeof(asset_format::MeshRecord) > size)
+		{
+			PALMX_ERROR("Cooked model is truncated");
+			return false;
+		}
+
+		// Every range has to lie inside the file, a corrupt record must not read past the mapping
+		auto in_file = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+
+		for (uint32_t i = 0; i < header.mesh_count; i++)
+		{
+			asset_format::MeshRecord record;
+			std::memcpy(&record, data + sizeof(header) + i * sizeof(record), sizeof(record));
+
+			if (!in_file(record.vertex_offset, record.vertex_data_size) || !in_file(record.index_offset, record.index_data_size) || !in_file(record.material_offset, record.material_length))
+			{
+				PALMX_ERROR("Cooked model is truncated");
+				return false;
+			}
+
+			if (record.vertex_data_size != static_cast<uint64_t>(record.vertex_count) * GetVertexSize(static_cast<VertexFormat>(record.vertex_format))
+				|| record.index_data_size != static_cast<uint64_t>(record.index_count) * record.index_size)
+			{
+				PALMX_ERROR("Cooked model mesh " << i << " has inconsistent sizes");
+				return false;
+			}
+
+			MeshView mesh;
+			mesh.info.format = static_cast<VertexFormat>(record.vertex_format);
+			mesh.info.vertex_count = record.vertex_count;
+			mesh.info.index_count = record.index_count;
+			mesh.info.index_size = record.index_size;
+			mesh.info.position_offset = glm::vec3(record.position_offset[0], record.position_offset[1], record.position_offset[2]);
+			mesh.info.position_scale = glm::vec3(record.position_scale[0], record.position_scale[1], record.position_scale[2]);
+			mesh.info.bounding_box.min = glm::vec3(record.bounds_min[0], record.bounds_min[1], record.bounds_min[2]);
+			mesh.info.bounding_box.max = glm::vec3(record.bounds_max[0], record.bounds_max[1], record.bounds_max[2]);
+			mesh.info.bounding_sphere.center = glm::vec3(record.sphere_center[0], record.sphere_center[1], record.sphere_center[2]);
+			mesh.info.bounding_sphere.radius = record.sphere_radius;
+			mesh.info.material_name.assign(reinterpret_cast<const char*>(data + record.material_offset), record.material_length);
+			mesh.vertices = data + record.vertex_offset;
+			mesh.vertices_size = record.vertex_data_size;
+			mesh.indices = data + record.index_offset;
+			mesh.indices_size = record.index_data_size;
+
+			meshes.push_back(std::move(mesh));
+		}
+
+		return true;
+	}
+
+	bool model_import::WriteCookedModel(const std::string& file_path, const std::vector<MeshData>& meshes)
+	{
+		asset_format::MeshHeader header = {};
+		std::memcpy(header.magic, asset_format::mesh_magic, sizeof(header.magic));
+		header.version = asset_format::mesh_version;
+		header.mesh_count = static_cast<uint32_t>(meshes.size());
+
+		// Lay out the blobs behind the record table
+		std::vector<asset_format::MeshRecord> records(meshes.size());
+		uint64_t offset = sizeof(header) + records.size() * sizeof(asset_format::MeshRecord);
+		auto align = [](uint64_t value) { return (value + 15) & ~uint64_t(15); };
+
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			const MeshInfo& info = meshes[i].info;
+			asset_format::MeshRecord& record = records[i];
+
+			record.vertex_format = info.format;
+			record.vertex_count = info.vertex_count;
+			record.index_count = info.index_count;
+			record.index_size = info.index_size;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				record.position_offset[axis] = info.position_offset[axis];
+				record.position_scale[axis] = info.position_scale[axis];
+				record.bounds_min[axis] = info.bounding_box.min[axis];
+				record.bounds_max[axis] = info.bounding_box.max[axis];
+				record.sphere_center[axis] = info.bounding_sphere.center[axis];
+			}
+			record.sphere_radius = info.bounding_sphere.radius;
+
+			record.material_offset = offset;
+			record.material_length = static_cast<uint32_t>(info.material_name.size());
+			offset = align(offset + record.material_length);
+
+			record.vertex_offset = offset;
+			record.vertex_data_size = meshes[i].vertices.size();
+			offset = align(offset + record.vertex_data_size);
+
+			record.index_offset = offset;
+			record.index_data_size = meshes[i].indices.size();
+			offset = align(offset + record.index_data_size);
+		}
+
+		std::ofstream file(file_path, std::ios::binary);
+		if (!file)
+		{
+			PALMX_ERROR("Failed to open " << file_path << " for writing");
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(asset_format::MeshRecord));
+
+		// Zero padding up to each aligned offset
+		auto write_at = [&file](uint64_t offset, const void* data, size_t size) {
+			static const char zeros[16] = {};
+			uint64_t position = static_cast<uint64_t>(file.tellp());
+			file.write(zeros, offset - position);
+			file.write(static_cast<const char*>(data), size);
+		};
+
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			write_at(records[i].material_offset, meshes[i].info.material_name.data(), meshes[i].info.material_name.size());
+			write_at(records[i].vertex_offset, meshes[i].vertices.data(), meshes[i].vertices.size());
+			write_at(records[i].index_offset, meshes[i].indices.data(), meshes[i].indices.size());
+		}
+
+		return static_cast<bool>(file);
+	}
+}
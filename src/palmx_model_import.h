@@ -0,0 +1,89 @@
+/**********************************************************************************************
+*
+*   palmx - internal model import header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_MODEL_IMPORT_H
+#define PALMX_MODEL_IMPORT_H
+
+#include <palmx.h>
+#include <palmx_math.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace palmx::model_import
+{
+	// Everything about a mesh except its vertex and index data
+	struct MeshInfo
+	{
+		VertexFormat format{ vertex_format::Standard };
+		uint32_t vertex_count{ 0 };
+		uint32_t index_count{ 0 };
+		uint32_t index_size{ 4 }; // 2 if every index fits into 16 bits, else 4
+
+		glm::vec3 position_offset{ glm::vec3(0, 0, 0) };
+		glm::vec3 position_scale{ glm::vec3(1, 1, 1) };
+
+		BoundingBox bounding_box;
+		BoundingSphere bounding_sphere;
+
+		std::string material_name;
+	};
+
+	// A mesh whose vertices and indices are already in the layout the GPU consumes
+	struct MeshData
+	{
+		MeshInfo info;
+		std::vector<uint8_t> vertices;
+		std::vector<uint8_t> indices;
+	};
+
+	// A mesh pointing into a memory mapped .pxmesh file
+	struct MeshView
+	{
+		MeshInfo info;
+		const uint8_t* vertices{ nullptr };
+		size_t vertices_size{ 0 };
+		const uint8_t* indices{ nullptr };
+		size_t indices_size{ 0 };
+	};
+
+	extern size_t GetVertexSize(VertexFormat format);
+
+#ifdef PALMX_USE_ASSIMP
+	// Run the full Assimp pipeline and convert every mesh into the requested vertex format
+	extern bool ImportModel(const std::string& file_path, VertexFormat format, std::vector<MeshData>& meshes);
+#endif
+
+	// Cooked meshes only reference the mapped data, so it must stay mapped while the views are used
+	extern bool ReadCookedModel(const uint8_t* data, size_t size, std::vector<MeshView>& meshes);
+	extern bool WriteCookedModel(const std::string& file_path, const std::vector<MeshData>& meshes);
+}
+
+#endif // PALMX_MODEL_IMPORT_H
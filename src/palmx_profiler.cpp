@@ -0,0 +1,223 @@
+/**********************************************************************************************
+*
+*   palmx - scope profiler with Chrome trace export
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include "palmx_profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+namespace palmx
+{
+#ifdef PALMX_PROFILE
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t start; // Nanoseconds since the capture started
+		uint64_t duration;
+	};
+
+	// Every thread records into its own buffer, the lock is only contended while a capture is written
+	struct ThreadBuffer
+	{
+		std::mutex mutex;
+		std::vector<ProfileEvent> events;
+		uint32_t thread_id;
+	};
+
+	static std::mutex buffers_mutex;
+	static std::vector<std::unique_ptr<ThreadBuffer>> buffers; // Never shrinks, threads keep pointers into it
+	static thread_local ThreadBuffer* thread_buffer{ nullptr };
+
+	static std::atomic<bool> capturing{ false };
+	static uint64_t capture_start{ 0 };
+	static uint32_t capture_frames_left{ 0 };
+	static uint32_t requested_frame_count{ 0 };
+	static std::string capture_path;
+	static uint64_t frame_start{ 0 };
+	static uint32_t main_thread_id{ 0 };
+
+	static uint64_t Now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	static ThreadBuffer& GetThreadBuffer()
+	{
+		if (thread_buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(buffers_mutex);
+			buffers.push_back(std::make_unique<ThreadBuffer>());
+			thread_buffer = buffers.back().get();
+			thread_buffer->thread_id = static_cast<uint32_t>(buffers.size());
+		}
+
+		return *thread_buffer;
+	}
+
+	static void Record(const char* name, uint64_t start, uint64_t end)
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+
+		std::lock_guard<std::mutex> lock(buffer.mutex);
+		// Scopes that started before the capture are clipped to its start
+		uint64_t clipped_start = std::max(start, capture_start);
+		buffer.events.push_back({ name, clipped_start - capture_start, end > clipped_start ? end - clipped_start : 0 });
+	}
+
+	profiler::Scope::Scope(const char* name) : name(name), start(capturing.load(std::memory_order_acquire) ? Now() : 0)
+	{
+	}
+
+	profiler::Scope::~Scope()
+	{
+		// Scopes opened before the capture started have no start time
+		if (start != 0 && capturing.load(std::memory_order_acquire))
+			Record(name, start, Now());
+	}
+
+	static void WriteJsonString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				file << '\\';
+			file << *c;
+		}
+		file << '"';
+	}
+
+	static void WriteCapture()
+	{
+		std::ofstream file(capture_path);
+		if (!file)
+		{
+			PALMX_ERROR("Failed to write profile capture to " << capture_path);
+			return;
+		}
+
+		// Trace event timestamps are in microseconds
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		size_t event_count = 0;
+
+		std::lock_guard<std::mutex> buffers_lock(buffers_mutex);
+		for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+		{
+			std::lock_guard<std::mutex> lock(buffer->mutex);
+
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+				<< ",\"args\":{\"name\":\"" << (buffer->thread_id == main_thread_id ? "Main" : "Worker") << " " << buffer->thread_id << "\"}}";
+			first = false;
+
+			for (const ProfileEvent& event : buffer->events)
+			{
+				file << ",\n{\"name\":";
+				WriteJsonString(file, event.name);
+				file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+			}
+
+			event_count += buffer->events.size();
+			buffer->events.clear();
+		}
+
+		file << "\n]}\n";
+
+		PALMX_INFO("Wrote profile capture with " << event_count << " events to " << capture_path);
+	}
+
+	void profiler::BeginFrame()
+	{
+		uint64_t now = Now();
+
+		if (capturing)
+		{
+			Record("Frame", frame_start, now);
+
+			if (--capture_frames_left == 0)
+			{
+				capturing = false;
+				WriteCapture();
+			}
+		}
+		else if (requested_frame_count > 0)
+		{
+			// Drop events of scopes that were still open when the last capture ended
+			{
+				std::lock_guard<std::mutex> buffers_lock(buffers_mutex);
+				for (const std::unique_ptr<ThreadBuffer>& buffer : buffers)
+				{
+					std::lock_guard<std::mutex> lock(buffer->mutex);
+					buffer->events.clear();
+				}
+			}
+
+			main_thread_id = GetThreadBuffer().thread_id;
+			capture_start = now;
+			capture_frames_left = requested_frame_count;
+			requested_frame_count = 0;
+			capturing = true;
+		}
+
+		frame_start = now;
+	}
+
+	void StartProfileCapture(uint32_t frame_count, const std::string& file_path)
+	{
+		if (capturing || frame_count == 0)
+			return;
+
+		requested_frame_count = frame_count;
+		capture_path = file_path;
+	}
+
+	bool IsProfileCaptureRunning()
+	{
+		return capturing || requested_frame_count > 0;
+	}
+#else
+	void profiler::BeginFrame()
+	{
+	}
+
+	void StartProfileCapture([[maybe_unused]] uint32_t frame_count, const std::string& file_path)
+	{
+		PALMX_WARN("Profiling is disabled, rebuild palmx with PALMX_PROFILE to capture " << file_path);
+	}
+
+	bool IsProfileCaptureRunning()
+	{
+		return false;
+	}
+#endif
+}
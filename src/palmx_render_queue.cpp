@@ -0,0 +1,423 @@
+/**********************************************************************************************
+*
+*   palmx - deferred render queue, sorts draw commands to minimize state changes
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include <glad/glad.h>
+
+#include "palmx_core.h"
+#include "palmx_gpu_timer.h"
+#include "palmx_graphics.h"
+#include "palmx_render_queue.h"
+#include "palmx_ui.h"
+
+#include <map>
+#include <mutex>
+
+namespace palmx
+{
+	using render_queue::DrawList;
+	using render_queue::SortEntry;
+
+	// Draws outside of a draw list go here, they come from the thread that called BeginDrawing
+	static DrawList main_list;
+	// Keyed by order, so merging walks them in the same order every frame no matter which thread finished first.
+	// Lists are kept across frames to reuse their memory.
+	static std::map<uint32_t, std::unique_ptr<DrawList>> draw_lists;
+	static std::mutex draw_lists_mutex;
+	static thread_local DrawList* current_list{ nullptr };
+
+	static std::vector<SortEntry> sort_scratch;
+	static const DrawList* submitted_list{ nullptr };
+
+	// Sentinel that never matches a real GL object so the first bind of a frame is always issued
+	static const unsigned int unknown_state{ 0xFFFFFFFF };
+	static const unsigned int max_texture_units{ 2 };
+
+	static unsigned int current_program{ unknown_state };
+	static unsigned int current_vao{ unknown_state };
+	static unsigned int current_textures[max_texture_units];
+	static unsigned int current_texture_unit{ unknown_state };
+	static int current_face_culling{ -1 };
+
+	static RenderStats frame_stats;
+	static RenderStats last_frame_stats;
+	static std::mutex last_frame_stats_mutex; // Written by the render thread, read by the game
+
+	// Key layout (most significant first):
+	// Scene: pass (2) | program (10) | texture (16) | vertex array (16) | depth (16) | unused (4)
+	// Ui:    pass (2) | unused (6) | layer (8) | unused (16) | sequence (32)
+	// GL object names are truncated, which can only merge otherwise unrelated groups, never break the draw
+	static const int pass_shift{ 62 };
+
+	uint64_t render_queue::MakeSceneKey(unsigned int program, unsigned int texture, unsigned int vao, float depth)
+	{
+		uint64_t quantized_depth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+
+		return (static_cast<uint64_t>(Pass::Scene) << pass_shift)
+			| (static_cast<uint64_t>(program & 0x3FF) << 52)
+			| (static_cast<uint64_t>(texture & 0xFFFF) << 36)
+			| (static_cast<uint64_t>(vao & 0xFFFF) << 20)
+			| (quantized_depth << 4);
+	}
+
+	uint64_t render_queue::MakeUiKey(uint8_t layer)
+	{
+		// Within a layer the UI keeps the order it was drawn in, overlapping elements would swap otherwise.
+		// Consecutive commands with the same texture still end up in one batch.
+		return (static_cast<uint64_t>(Pass::Ui) << pass_shift)
+			| (static_cast<uint64_t>(layer) << 48)
+			| GetDrawList().ui_sequence++;
+	}
+
+	void render_queue::Clear(DrawList& list)
+	{
+		list.commands.clear();
+		list.sort_entries.clear();
+		list.instance_transforms.clear();
+		list.text_vertices.clear();
+		list.ui_sequence = 0;
+		list.objects_drawn = 0;
+		list.objects_culled = 0;
+	}
+
+	void render_queue::Begin()
+	{
+		Clear(main_list);
+
+		std::lock_guard<std::mutex> lock(draw_lists_mutex);
+		for (auto& [order, list] : draw_lists)
+		{
+			Clear(*list);
+		}
+	}
+
+	DrawList& render_queue::GetDrawList()
+	{
+		return current_list != nullptr ? *current_list : main_list;
+	}
+
+	DrawList* render_queue::SetDrawList(DrawList* list)
+	{
+		DrawList* previous = current_list;
+		current_list = list;
+		return previous;
+	}
+
+	void render_queue::Push(uint64_t key, const Command& command)
+	{
+		DrawList& list = GetDrawList();
+		list.sort_entries.push_back({ key, static_cast<uint32_t>(list.commands.size()) });
+		list.commands.push_back(command);
+	}
+
+	static void AppendDrawList(DrawList& destination, const DrawList& source)
+	{
+		uint32_t command_base = static_cast<uint32_t>(destination.commands.size());
+		uint32_t instance_base = static_cast<uint32_t>(destination.instance_transforms.size());
+		uint32_t text_base = static_cast<uint32_t>(destination.text_vertices.size());
+
+		// UI commands keep their recording order behind everything recorded before them
+		for (SortEntry entry : source.sort_entries)
+		{
+			if ((entry.key >> pass_shift) == static_cast<uint64_t>(render_queue::Pass::Ui))
+				entry.key += destination.ui_sequence;
+
+			entry.index += command_base;
+			destination.sort_entries.push_back(entry);
+		}
+
+		for (render_queue::Command command : source.commands)
+		{
+			if (command.instance_count > 0)
+				command.data_index += instance_base;
+			else if (command.type == render_queue::CommandType::Text)
+				command.data_index += text_base;
+
+			destination.commands.push_back(command);
+		}
+
+		destination.instance_transforms.insert(destination.instance_transforms.end(), source.instance_transforms.begin(), source.instance_transforms.end());
+		destination.text_vertices.insert(destination.text_vertices.end(), source.text_vertices.begin(), source.text_vertices.end());
+		destination.ui_sequence += source.ui_sequence;
+		destination.objects_drawn += source.objects_drawn;
+		destination.objects_culled += source.objects_culled;
+	}
+
+	void render_queue::Append(const DrawList& list)
+	{
+		AppendDrawList(GetDrawList(), list);
+	}
+
+	DrawList& render_queue::Merge()
+	{
+		PALMX_PROFILE_SCOPE("MergeDrawLists");
+
+		PALMX_ASSERT((current_list == nullptr), "EndDrawList has to be called before EndDrawing");
+
+		std::lock_guard<std::mutex> lock(draw_lists_mutex);
+		for (auto& [order, list] : draw_lists)
+		{
+			PALMX_ASSERT(!list->recording, "Draw list " << order << " is still recording in EndDrawing");
+
+			AppendDrawList(main_list, *list);
+		}
+
+		return main_list;
+	}
+
+	// Stable LSD radix sort over 8-bit digits, digits that are equal for every key are skipped
+	static void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+	{
+		const size_t count = entries.size();
+		if (count < 2)
+			return;
+
+		uint32_t histograms[8][256] = {};
+		for (const SortEntry& entry : entries)
+		{
+			for (int digit = 0; digit < 8; digit++)
+			{
+				histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+			}
+		}
+
+		scratch.resize(count);
+		std::vector<SortEntry>* source = &entries;
+		std::vector<SortEntry>* destination = &scratch;
+
+		for (int digit = 0; digit < 8; digit++)
+		{
+			uint32_t* histogram = histograms[digit];
+			if (histogram[((*source)[0].key >> (digit * 8)) & 0xFF] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				uint32_t bucket_count = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucket_count;
+			}
+
+			for (const SortEntry& entry : *source)
+			{
+				(*destination)[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+			}
+
+			std::swap(source, destination);
+		}
+
+		if (source != &entries)
+		{
+			entries.swap(scratch);
+		}
+	}
+
+	static void ResetRenderState()
+	{
+		current_program = unknown_state;
+		current_vao = unknown_state;
+		current_texture_unit = unknown_state;
+		current_face_culling = -1;
+		std::fill(std::begin(current_textures), std::end(current_textures), unknown_state);
+	}
+
+	void render_queue::ResetStats(const DrawList& list)
+	{
+		frame_stats = {};
+		frame_stats.objects_drawn = list.objects_drawn;
+		frame_stats.objects_culled = list.objects_culled;
+	}
+
+	void render_queue::Submit(DrawList& list)
+	{
+		PALMX_PROFILE_SCOPE("SubmitRenderQueue");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		ResetRenderState();
+		submitted_list = &list;
+
+		// The radix sort is stable, commands with equal keys stay in merge order
+		RadixSort(list.sort_entries, sort_scratch);
+
+		// Scene commands sort before UI commands, the UI timer starts at the first UI command
+		bool ui_pass_started = false;
+
+		for (const SortEntry& entry : list.sort_entries)
+		{
+			if (!ui_pass_started && (entry.key >> pass_shift) == static_cast<uint64_t>(Pass::Ui))
+			{
+				gpu_timer::BeginPass(gpu_pass::Ui);
+				ui_pass_started = true;
+			}
+
+			const Command& command = list.commands[entry.index];
+			switch (command.type)
+			{
+			case CommandType::Mesh:
+			case CommandType::Primitive:
+				graphics::ExecuteCommand(command);
+				break;
+			case CommandType::Sprite:
+			case CommandType::Text:
+				ui::ExecuteCommand(command);
+				break;
+			}
+		}
+
+		if (!ui_pass_started)
+			gpu_timer::BeginPass(gpu_pass::Ui);
+
+		// Draw the last sprite batch
+		ui::FlushBatch();
+
+		// Leave the context in its default state for anything drawn outside of the queue
+		glBindVertexArray(0);
+		for (unsigned int unit = 0; unit < max_texture_units; unit++)
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		glActiveTexture(GL_TEXTURE0);
+		glEnable(GL_CULL_FACE);
+		ResetRenderState();
+		submitted_list = nullptr;
+
+		std::lock_guard<std::mutex> lock(last_frame_stats_mutex);
+		last_frame_stats = frame_stats;
+	}
+
+	const DrawList& render_queue::GetSubmittedList()
+	{
+		PALMX_ASSERT((submitted_list != nullptr), "No frame is being submitted");
+
+		return *submitted_list;
+	}
+
+	void render_queue::UseProgram(unsigned int program)
+	{
+		if (current_program == program)
+			return;
+
+		glUseProgram(program);
+		current_program = program;
+		frame_stats.program_binds++;
+	}
+
+	void render_queue::BindVertexArray(unsigned int vao)
+	{
+		if (current_vao == vao)
+			return;
+
+		glBindVertexArray(vao);
+		current_vao = vao;
+		frame_stats.vertex_array_binds++;
+	}
+
+	void render_queue::BindTexture(unsigned int unit, unsigned int texture)
+	{
+		PALMX_ASSERT((unit < max_texture_units), "Texture unit out of range");
+
+		if (current_textures[unit] == texture)
+			return;
+
+		if (current_texture_unit != unit)
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			current_texture_unit = unit;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+		current_textures[unit] = texture;
+		frame_stats.texture_binds++;
+	}
+
+	void render_queue::SetFaceCulling(bool enabled)
+	{
+		if (current_face_culling == static_cast<int>(enabled))
+			return;
+
+		if (enabled)
+			glEnable(GL_CULL_FACE);
+		else
+			glDisable(GL_CULL_FACE);
+
+		current_face_culling = static_cast<int>(enabled);
+	}
+
+	void render_queue::CountDrawCall()
+	{
+		frame_stats.draw_calls++;
+	}
+
+	void render_queue::CountObjects(uint32_t drawn, uint32_t culled)
+	{
+		DrawList& list = GetDrawList();
+		list.objects_drawn += drawn;
+		list.objects_culled += culled;
+	}
+
+	void render_queue::CountBytesStreamed(size_t size)
+	{
+		frame_stats.bytes_streamed += static_cast<uint32_t>(size);
+	}
+
+	void BeginDrawList(uint32_t order)
+	{
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+		PALMX_ASSERT((current_list == nullptr), "Draw lists cannot be nested");
+
+		std::lock_guard<std::mutex> lock(draw_lists_mutex);
+
+		std::unique_ptr<DrawList>& list = draw_lists[order];
+		if (!list)
+			list = std::make_unique<DrawList>();
+
+		PALMX_ASSERT(!list->recording, "Draw list " << order << " is already recording on another thread");
+
+		list->recording = true;
+		current_list = list.get();
+	}
+
+	void EndDrawList()
+	{
+		PALMX_ASSERT((current_list != nullptr), "EndDrawList called without BeginDrawList");
+
+		std::lock_guard<std::mutex> lock(draw_lists_mutex);
+		current_list->recording = false;
+		current_list = nullptr;
+	}
+
+	RenderStats GetRenderStats()
+	{
+		std::lock_guard<std::mutex> lock(last_frame_stats_mutex);
+		return last_frame_stats;
+	}
+}
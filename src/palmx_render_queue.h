@@ -0,0 +1,139 @@
+/**********************************************************************************************
+*
+*   palmx - internal render queue header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_RENDER_QUEUE_H
+#define PALMX_RENDER_QUEUE_H
+
+#include <palmx.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace palmx::render_queue
+{
+	enum class Pass : uint8_t
+	{
+		Scene = 0, // 3D geometry, sorted by render state and depth
+		Ui = 1 // Sprites and text, drawn on top by layer in call order
+	};
+
+	enum class CommandType : uint8_t
+	{
+		Mesh,
+		Primitive,
+		Sprite,
+		Text
+	};
+
+	// Everything needed to execute a draw without referencing the caller's objects
+	struct Command
+	{
+		CommandType type;
+		unsigned int vao;
+		unsigned int textures[2];
+		unsigned int element_count;
+		unsigned int index_type;
+		glm::mat4 transform;
+		glm::vec3 position; // Model position for meshes, baseline origin for text
+		float scale;
+		Color color;
+		uint32_t data_index; // Index into per-frame storage of the owning module (e.g. text, first instance)
+		uint32_t instance_count; // Zero for regular draws
+		glm::vec3 position_offset; // Dequantization of mesh vertex positions
+		glm::vec3 position_scale;
+		glm::vec4 uv_rect; // Texture region of sprites (min, max)
+	};
+
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// Vertex format shared by sprites and text, both are streamed in batches
+	struct BatchVertex
+	{
+		glm::vec2 position;
+		glm::vec2 tex_coords;
+		uint32_t color; // RGBA8
+	};
+
+	// Commands and the per-frame data they reference, recorded by one thread at a time
+	struct DrawList
+	{
+		std::vector<Command> commands;
+		std::vector<SortEntry> sort_entries;
+		std::vector<glm::mat4> instance_transforms; // Instanced commands reference their range through data_index
+		std::vector<BatchVertex> text_vertices; // Text commands reference their glyph quads through data_index
+		uint32_t ui_sequence{ 0 };
+		uint32_t objects_drawn{ 0 };
+		uint32_t objects_culled{ 0 };
+		bool recording{ false };
+	};
+
+	extern uint64_t MakeSceneKey(unsigned int program, unsigned int texture, unsigned int vao, float depth);
+	extern uint64_t MakeUiKey(uint8_t layer);
+
+	// Start recording a new frame, clears the main list and all draw lists
+	extern void Begin();
+	// The list the calling thread records into, the main list outside of BeginDrawList/EndDrawList
+	extern DrawList& GetDrawList();
+	// Record the calling thread's draws into a list owned by the caller (nullptr for the main list), returns the previous list.
+	// Lets internal work spread over jobs record into private lists that are appended in a fixed order afterwards.
+	extern DrawList* SetDrawList(DrawList* list);
+	// Append a list to the calling thread's list, rebasing its data and UI sequence
+	extern void Append(const DrawList& list);
+	extern void Clear(DrawList& list);
+	// Append a command to the calling thread's list, it is executed in key order when the frame is submitted
+	extern void Push(uint64_t key, const Command& command);
+	// Append all draw lists to the main list in ascending order, rebasing their data and UI sequence.
+	// Returns the main list, which then holds the whole frame.
+	extern DrawList& Merge();
+	// Start the statistics of a frame about to be submitted, the culling results come from its list
+	extern void ResetStats(const DrawList& list);
+	// Sort all commands of a merged frame and execute them. The list may be swapped out of the main list,
+	// so the render thread can submit one frame while the next one is recorded.
+	extern void Submit(DrawList& list);
+	// The list being submitted, commands read their per-frame data from it
+	extern const DrawList& GetSubmittedList();
+
+	// Cached render state, binds are skipped if the state is already set
+	extern void UseProgram(unsigned int program);
+	extern void BindVertexArray(unsigned int vao);
+	extern void BindTexture(unsigned int unit, unsigned int texture);
+	extern void SetFaceCulling(bool enabled);
+	extern void CountDrawCall();
+	// Record the result of a frustum culling test for the frame statistics
+	extern void CountObjects(uint32_t drawn, uint32_t culled);
+	extern void CountBytesStreamed(size_t size);
+}
+
+#endif // PALMX_RENDER_QUEUE_H
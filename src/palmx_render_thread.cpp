@@ -0,0 +1,197 @@
+/**********************************************************************************************
+*
+*   palmx - render thread owning the GL context
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+
+#include "pxpch.h"
+
+#include "palmx_core.h"
+#include "palmx_graphics.h"
+#include "palmx_render_thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace palmx
+{
+	struct Invocation
+	{
+		const std::function<void()>* function;
+		bool done;
+	};
+
+	static std::thread context_thread;
+	// Set once the render thread published its id, other threads only read the id after seeing this
+	static std::atomic<bool> enabled{ false };
+
+	// Guards everything below, the condition is signaled whenever any of it changes
+	static std::mutex render_thread_mutex;
+	static std::condition_variable render_thread_condition;
+	static std::thread::id render_thread_id;
+	static bool started{ false };
+	static bool frame_pending{ false };
+	static std::deque<Invocation*> invocations;
+	static bool stopping{ false };
+
+	static void RenderThreadLoop()
+	{
+		glfwMakeContextCurrent(px_data.window);
+
+		std::unique_lock<std::mutex> lock(render_thread_mutex);
+		render_thread_id = std::this_thread::get_id();
+		started = true;
+		render_thread_condition.notify_all();
+
+		while (true)
+		{
+			render_thread_condition.wait(lock, [] { return stopping || frame_pending || !invocations.empty(); });
+
+			// Calls first, a frame may draw what they just loaded
+			while (!invocations.empty())
+			{
+				Invocation* invocation = invocations.front();
+				invocations.pop_front();
+
+				lock.unlock();
+				(*invocation->function)();
+				lock.lock();
+
+				invocation->done = true;
+				render_thread_condition.notify_all();
+			}
+
+			if (frame_pending)
+			{
+				lock.unlock();
+				graphics::RenderFrame();
+				lock.lock();
+
+				frame_pending = false;
+				render_thread_condition.notify_all();
+				continue;
+			}
+
+			if (stopping)
+				break;
+		}
+
+		glfwMakeContextCurrent(nullptr);
+	}
+
+	void render_thread::Init()
+	{
+		PALMX_ASSERT(!enabled, "The render thread cannot be started twice");
+
+		// A context can only be current on one thread at a time
+		glfwMakeContextCurrent(nullptr);
+
+		stopping = false;
+		started = false;
+		context_thread = std::thread(RenderThreadLoop);
+
+		// Nothing may ask for the context thread before the render thread made the context current
+		{
+			std::unique_lock<std::mutex> lock(render_thread_mutex);
+			render_thread_condition.wait(lock, [] { return started; });
+		}
+		enabled = true;
+
+		PALMX_INFO("Started render thread");
+	}
+
+	void render_thread::Shutdown()
+	{
+		if (!enabled)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(render_thread_mutex);
+			stopping = true;
+		}
+		render_thread_condition.notify_all();
+
+		context_thread.join();
+		enabled = false;
+
+		glfwMakeContextCurrent(px_data.window);
+	}
+
+	bool render_thread::IsEnabled()
+	{
+		return enabled;
+	}
+
+	bool render_thread::IsContextThread()
+	{
+		return !enabled || std::this_thread::get_id() == render_thread_id;
+	}
+
+	void render_thread::WaitForFrame()
+	{
+		if (!enabled)
+			return;
+
+		PALMX_PROFILE_SCOPE("WaitForRenderThread");
+
+		std::unique_lock<std::mutex> lock(render_thread_mutex);
+		render_thread_condition.wait(lock, [] { return !frame_pending; });
+	}
+
+	void render_thread::StartFrame()
+	{
+		PALMX_ASSERT(enabled, "The render thread is not running");
+
+		{
+			std::lock_guard<std::mutex> lock(render_thread_mutex);
+			PALMX_ASSERT(!frame_pending, "The render thread is still busy with the last frame");
+			frame_pending = true;
+		}
+		render_thread_condition.notify_all();
+	}
+
+	void render_thread::Run(const std::function<void()>& function)
+	{
+		if (IsContextThread())
+		{
+			function();
+			return;
+		}
+
+		PALMX_PROFILE_SCOPE("RunOnRenderThread");
+
+		Invocation invocation = { &function, false };
+
+		std::unique_lock<std::mutex> lock(render_thread_mutex);
+		invocations.push_back(&invocation);
+		render_thread_condition.notify_all();
+		render_thread_condition.wait(lock, [&invocation] { return invocation.done; });
+	}
+}
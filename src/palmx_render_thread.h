@@ -0,0 +1,74 @@
+/**********************************************************************************************
+*
+*   palmx - internal render thread header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_RENDER_THREAD_H
+#define PALMX_RENDER_THREAD_H
+
+#include <functional>
+#include <type_traits>
+
+namespace palmx::render_thread
+{
+	// Hand the GL context of the calling thread over to a new render thread
+	extern void Init();
+	// Finish the running frame and calls, then take the context back on the calling thread
+	extern void Shutdown();
+
+	extern bool IsEnabled();
+	// Is the calling thread allowed to make GL calls? Always true without a render thread.
+	extern bool IsContextThread();
+
+	// Block until the render thread finished the frame it is working on
+	extern void WaitForFrame();
+	// Let the render thread render the submitted frame (graphics::RenderFrame)
+	extern void StartFrame();
+
+	// Run function on the render thread between frames, returns once it ran
+	extern void Run(const std::function<void()>& function);
+
+	// Run function where GL calls are allowed and return its result
+	template<typename Function>
+	auto Invoke(Function&& function) -> decltype(function())
+	{
+		using Result = decltype(function());
+
+		if constexpr (std::is_void_v<Result>)
+		{
+			Run([&function]() { function(); });
+		}
+		else
+		{
+			Result result{};
+			Run([&function, &result]() { result = function(); });
+			return result;
+		}
+	}
+}
+
+#endif // PALMX_RENDER_THREAD_H
@@ -0,0 +1,353 @@
+/**********************************************************************************************
+*
+*   palmx - retained scene with hierarchical culling and spatial queries
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+
+#include "palmx_aabb_tree.h"
+#include "palmx_core.h"
+#include "palmx_graphics.h"
+#include "palmx_render_queue.h"
+#include "palmx_ui.h"
+
+#include <palmx_jobs.h>
+#include <palmx_math.h>
+
+#include <glm/glm.hpp>
+
+namespace palmx
+{
+	enum class SceneObjectType : uint8_t
+	{
+		Model,
+		Primitive,
+		Sprite
+	};
+
+	struct SceneObject
+	{
+		SceneObjectType type;
+		const Model* model{ nullptr };
+		const Primitive* primitive{ nullptr };
+		const Sprite* sprite{ nullptr };
+
+		TransformId transform{ 0 };
+		BoundingBox local_box;
+		BoundingBox world_box;
+
+		int32_t proxy{ AabbTree::null_node };
+		bool dirty{ false };
+		bool alive{ false };
+	};
+
+	// Margins of the fat boxes, objects can move this far before their leaf is reinserted
+	static AabbTree world_tree(0.1f);
+	static AabbTree screen_tree(4.0f);
+
+	static std::vector<SceneObject> scene_objects;
+	static std::vector<SceneHandle> free_scene_handles;
+	static std::vector<SceneHandle> dirty_scene_handles;
+	static uint32_t world_object_count{ 0 }; // Alive models and primitives, the culling statistics need it every frame
+
+	// Visible objects are queued in chunks of this size, each chunk records into its own list on the job system
+	static const size_t scene_chunk_size{ 256 };
+	static std::vector<render_queue::DrawList> scene_chunk_lists; // Kept across frames to reuse their memory
+
+	// Sprites are quads spanning -1 to 1 before their transform is applied
+	static const BoundingBox sprite_local_box = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f) };
+
+	static AabbTree& GetTree(const SceneObject& object)
+	{
+		return object.type == SceneObjectType::Sprite ? screen_tree : world_tree;
+	}
+
+	static SceneObject& GetSceneObject(SceneHandle handle)
+	{
+		PALMX_ASSERT((handle < scene_objects.size() && scene_objects[handle].alive), "Invalid scene handle");
+
+		return scene_objects[handle];
+	}
+
+	static SceneHandle AddSceneObject(SceneObject object, const Transform& transform)
+	{
+		object.alive = true;
+		object.transform = CreateTransform(transform);
+		object.world_box = TransformBoundingBox(object.local_box, GetWorldMatrix(object.transform));
+
+		SceneHandle handle;
+		if (!free_scene_handles.empty())
+		{
+			handle = free_scene_handles.back();
+			free_scene_handles.pop_back();
+			scene_objects[handle] = object;
+		}
+		else
+		{
+			handle = static_cast<SceneHandle>(scene_objects.size());
+			scene_objects.push_back(object);
+		}
+
+		SceneObject& added = scene_objects[handle];
+		added.proxy = GetTree(added).CreateProxy(added.world_box, handle);
+		if (added.type != SceneObjectType::Sprite)
+			world_object_count++;
+
+		return handle;
+	}
+
+	SceneHandle AddToScene(const Model& model)
+	{
+		SceneObject object;
+		object.type = SceneObjectType::Model;
+		object.model = &model;
+		object.local_box = GetModelBoundingBox(model);
+
+		return AddSceneObject(object, model.transform);
+	}
+
+	SceneHandle AddToScene(const Primitive& primitive)
+	{
+		SceneObject object;
+		object.type = SceneObjectType::Primitive;
+		object.primitive = &primitive;
+		object.local_box = primitive.bounding_box;
+
+		return AddSceneObject(object, primitive.transform);
+	}
+
+	SceneHandle AddToScene(const Sprite& sprite)
+	{
+		SceneObject object;
+		object.type = SceneObjectType::Sprite;
+		object.sprite = &sprite;
+		object.local_box = sprite_local_box;
+
+		return AddSceneObject(object, sprite.transform);
+	}
+
+	void RemoveFromScene(SceneHandle handle)
+	{
+		SceneObject& object = GetSceneObject(handle);
+
+		GetTree(object).DestroyProxy(object.proxy);
+		DestroyTransform(object.transform);
+		if (object.type != SceneObjectType::Sprite)
+			world_object_count--;
+
+		object = SceneObject();
+
+		free_scene_handles.push_back(handle);
+	}
+
+	void SetSceneTransform(SceneHandle handle, const Transform& transform)
+	{
+		SceneObject& object = GetSceneObject(handle);
+		SetTransform(object.transform, transform);
+
+		if (!object.dirty)
+		{
+			object.dirty = true;
+			dirty_scene_handles.push_back(handle);
+		}
+	}
+
+	Transform GetSceneTransform(SceneHandle handle)
+	{
+		return GetTransform(GetSceneObject(handle).transform);
+	}
+
+	// Only objects whose transform changed since the last update are touched
+	static void UpdateScene()
+	{
+		UpdateTransforms();
+
+		for (SceneHandle handle : dirty_scene_handles)
+		{
+			SceneObject& object = scene_objects[handle];
+			if (!object.alive || !object.dirty)
+				continue;
+
+			object.dirty = false;
+			object.world_box = TransformBoundingBox(object.local_box, GetWorldMatrix(object.transform));
+
+			GetTree(object).MoveProxy(object.proxy, object.world_box);
+		}
+
+		dirty_scene_handles.clear();
+	}
+
+	void DrawScene()
+	{
+		PALMX_PROFILE_SCOPE("DrawScene");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		UpdateScene();
+
+		std::vector<AabbTree::FrustumResult> visible;
+		world_tree.Query(graphics::GetCameraFrustum(), visible);
+
+		// Subtrees outside the frustum were never visited, count their objects as culled
+		render_queue::CountObjects(0, world_object_count - static_cast<uint32_t>(visible.size()));
+
+		// Chunks are appended in order afterwards, so the frame does not depend on which job finished first
+		size_t chunk_count = (visible.size() + scene_chunk_size - 1) / scene_chunk_size;
+		if (scene_chunk_lists.size() < chunk_count)
+			scene_chunk_lists.resize(chunk_count);
+
+		ParallelFor(chunk_count, [&](size_t chunk) {
+			render_queue::DrawList& list = scene_chunk_lists[chunk];
+			render_queue::Clear(list);
+			render_queue::DrawList* previous_list = render_queue::SetDrawList(&list);
+
+			size_t end = std::min(visible.size(), (chunk + 1) * scene_chunk_size);
+			for (size_t i = chunk * scene_chunk_size; i < end; i++)
+			{
+				const AabbTree::FrustumResult& result = visible[i];
+				const SceneObject& object = scene_objects[result.user_data];
+
+				// Objects that are only partially inside still get their meshes culled individually
+				if (object.type == SceneObjectType::Model)
+				{
+					graphics::QueueModel(*object.model, GetWorldMatrix(object.transform), !result.fully_inside);
+				}
+				else
+				{
+					graphics::QueuePrimitive(*object.primitive, GetWorldMatrix(object.transform), !result.fully_inside);
+				}
+			}
+
+			// A job may run on a thread that is recording its own list while it waits
+			render_queue::SetDrawList(previous_list);
+		});
+
+		for (size_t chunk = 0; chunk < chunk_count; chunk++)
+		{
+			render_queue::Append(scene_chunk_lists[chunk]);
+		}
+
+		glm::vec2 window_size = GetWindowSize();
+		BoundingBox window_box = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(window_size.x, window_size.y, 1.0f) };
+
+		std::vector<uint32_t> visible_sprites;
+		screen_tree.Query(window_box, visible_sprites);
+
+		// Keep sprites in registration order so overlapping sprites are layered deterministically
+		std::sort(visible_sprites.begin(), visible_sprites.end());
+
+		for (uint32_t handle : visible_sprites)
+		{
+			const SceneObject& object = scene_objects[handle];
+			ui::QueueSprite(*object.sprite, GetWorldMatrix(object.transform));
+		}
+	}
+
+	std::vector<SceneHandle> QueryScene(const BoundingBox& box)
+	{
+		UpdateScene();
+
+		std::vector<uint32_t> candidates;
+		world_tree.Query(box, candidates);
+
+		// The tree stores fat boxes, filter with the exact bounds
+		std::vector<SceneHandle> results;
+		for (uint32_t handle : candidates)
+		{
+			const BoundingBox& world_box = scene_objects[handle].world_box;
+			if (world_box.min.x <= box.max.x && world_box.min.y <= box.max.y && world_box.min.z <= box.max.z
+				&& box.min.x <= world_box.max.x && box.min.y <= world_box.max.y && box.min.z <= world_box.max.z)
+			{
+				results.push_back(handle);
+			}
+		}
+
+		return results;
+	}
+
+	std::vector<SceneHandle> QuerySceneSprites(const BoundingBox& screen_box)
+	{
+		UpdateScene();
+
+		BoundingBox box = { glm::vec3(screen_box.min.x, screen_box.min.y, -1.0f), glm::vec3(screen_box.max.x, screen_box.max.y, 1.0f) };
+
+		std::vector<uint32_t> candidates;
+		screen_tree.Query(box, candidates);
+
+		std::vector<SceneHandle> results;
+		for (uint32_t handle : candidates)
+		{
+			const BoundingBox& world_box = scene_objects[handle].world_box;
+			if (world_box.min.x <= box.max.x && world_box.min.y <= box.max.y
+				&& box.min.x <= world_box.max.x && box.min.y <= world_box.max.y)
+			{
+				results.push_back(handle);
+			}
+		}
+
+		return results;
+	}
+
+	bool RaycastScene(glm::vec3 origin, glm::vec3 direction, float max_distance, SceneRaycastHit& hit)
+	{
+		UpdateScene();
+
+		glm::vec3 normalized_direction = glm::normalize(direction);
+		glm::vec3 inverse_direction = glm::vec3(1.0f) / normalized_direction;
+
+		std::vector<AabbTree::RaycastResult> candidates;
+		world_tree.Raycast(origin, normalized_direction, max_distance, candidates);
+
+		// Candidates are sorted by the distance to their fat box, refine with the exact bounds
+		bool found = false;
+		for (const AabbTree::RaycastResult& candidate : candidates)
+		{
+			if (found && candidate.distance > hit.distance)
+				break;
+
+			const BoundingBox& box = scene_objects[candidate.user_data].world_box;
+
+			float t_min = 0.0f;
+			float t_max = max_distance;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float t1 = (box.min[axis] - origin[axis]) * inverse_direction[axis];
+				float t2 = (box.max[axis] - origin[axis]) * inverse_direction[axis];
+				t_min = glm::max(t_min, glm::min(t1, t2));
+				t_max = glm::min(t_max, glm::max(t1, t2));
+			}
+
+			if (t_min <= t_max && (!found || t_min < hit.distance))
+			{
+				hit = { candidate.user_data, t_min };
+				found = true;
+			}
+		}
+
+		return found;
+	}
+}
@@ -0,0 +1,272 @@
+/**********************************************************************************************
+*
+*   palmx - ring buffer for data streamed to the GPU every frame
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include <glad/glad.h>
+
+#include "palmx_core.h"
+#include "palmx_render_queue.h"
+#include "palmx_stream_buffer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <vector>
+
+namespace palmx
+{
+	// Frames the CPU may be ahead of the GPU, each one owns a segment of the ring
+	static const uint32_t frames_in_flight{ 3 };
+	static size_t segment_size{ 4 * 1024 * 1024 }; // Doubled whenever a frame did not fit
+
+	static GLuint stream_buffer_id;
+	static bool persistent{ false };
+	static uint8_t* persistent_data{ nullptr };
+
+	static GLsync segment_fences[frames_in_flight];
+	static uint32_t current_segment{ 0 };
+	static size_t segment_head{ 0 };
+
+	// Data that did not fit into the frame's segment goes to one-off buffers, the ring grows before the next frame
+	static std::vector<GLuint> overflow_buffers;
+	static size_t overflow_bytes{ 0 };
+
+	static bool HasExtension(const char* name)
+	{
+		GLint extension_count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+
+		for (GLint i = 0; i < extension_count; i++)
+		{
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension != nullptr && std::strcmp(extension, name) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	// Storage is immutable with buffer storage, so the persistent ring is recreated to resize it
+	static void CreatePersistentStorage()
+	{
+		glGenBuffers(1, &stream_buffer_id);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stream_buffer_id);
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, segment_size * frames_in_flight, nullptr, flags);
+		persistent_data = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, segment_size * frames_in_flight, flags));
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	static void Grow(size_t required_size)
+	{
+		while (segment_size < required_size)
+			segment_size *= 2;
+
+		if (persistent)
+		{
+			// Every segment of the old ring has to be retired before its storage can go away
+			for (GLsync& fence : segment_fences)
+			{
+				if (fence == nullptr)
+					continue;
+
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, stream_buffer_id);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &stream_buffer_id);
+
+			CreatePersistentStorage();
+			current_segment = 0;
+		}
+
+		PALMX_INFO("Stream buffer grown to " << segment_size << " bytes per frame");
+	}
+
+	void stream_buffer::Init()
+	{
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		// The context is 3.3, so glad only loads glBufferStorage for 4.4+ drivers. Drivers exposing the
+		// extension on older contexts have to be loaded manually (the ARB entry point has the same name).
+		if (glBufferStorage == nullptr && HasExtension("GL_ARB_buffer_storage"))
+		{
+			glad_glBufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(glfwGetProcAddress("glBufferStorage"));
+		}
+
+		persistent = glBufferStorage != nullptr;
+
+		if (persistent)
+		{
+			CreatePersistentStorage();
+
+			PALMX_INFO("Streaming through a persistently mapped buffer");
+		}
+		else
+		{
+			glGenBuffers(1, &stream_buffer_id);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, stream_buffer_id);
+			glBufferData(GL_COPY_WRITE_BUFFER, segment_size, nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+			PALMX_INFO("Buffer storage not available, streaming through buffer orphaning");
+		}
+	}
+
+	void stream_buffer::BeginFrame()
+	{
+		// The driver keeps the storage of last frame's overflow buffers alive until the GPU is done with it
+		if (!overflow_buffers.empty())
+		{
+			glDeleteBuffers(static_cast<GLsizei>(overflow_buffers.size()), overflow_buffers.data());
+			overflow_buffers.clear();
+		}
+
+		if (overflow_bytes > 0)
+		{
+			Grow(segment_head + overflow_bytes);
+			overflow_bytes = 0;
+		}
+
+		segment_head = 0;
+
+		if (persistent)
+		{
+			current_segment = (current_segment + 1) % frames_in_flight;
+
+			// Only blocks if the GPU is more than frames_in_flight frames behind
+			GLsync fence = segment_fences[current_segment];
+			if (fence != nullptr)
+			{
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+
+				glDeleteSync(fence);
+				segment_fences[current_segment] = nullptr;
+			}
+		}
+		else
+		{
+			// Detach last frame's storage, the driver keeps it alive until the GPU is done with it
+			glBindBuffer(GL_COPY_WRITE_BUFFER, stream_buffer_id);
+			glBufferData(GL_COPY_WRITE_BUFFER, segment_size, nullptr, GL_STREAM_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+	}
+
+	void stream_buffer::EndFrame()
+	{
+		if (persistent && segment_head > 0)
+		{
+			segment_fences[current_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	// Gets a buffer of its own, so nothing the GPU still reads has to be waited on
+	static stream_buffer::Allocation AllocateOverflow(size_t size, size_t alignment)
+	{
+		overflow_bytes += size + alignment;
+
+		stream_buffer::Allocation allocation = {};
+		glGenBuffers(1, &allocation.buffer);
+		overflow_buffers.push_back(allocation.buffer);
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		return allocation;
+	}
+
+	stream_buffer::Allocation stream_buffer::Allocate(size_t size, size_t alignment)
+	{
+		// Align the offset inside the whole buffer, draws address their data in units of the alignment
+		size_t segment_start = persistent ? current_segment * segment_size : 0;
+		size_t offset = (segment_start + segment_head + alignment - 1) / alignment * alignment - segment_start;
+
+		render_queue::CountBytesStreamed(size);
+
+		if (offset + size > segment_size)
+			return AllocateOverflow(size, alignment);
+
+		segment_head = offset + size;
+
+		Allocation allocation = {};
+		allocation.buffer = stream_buffer_id;
+
+		if (persistent)
+		{
+			allocation.offset = segment_start + offset;
+			allocation.data = persistent_data + allocation.offset;
+		}
+		else
+		{
+			// Nothing else of this frame's storage is in use, so the map never has to wait for the GPU
+			allocation.offset = offset;
+
+			glBindBuffer(GL_COPY_WRITE_BUFFER, stream_buffer_id);
+			allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+
+		return allocation;
+	}
+
+	void stream_buffer::Commit(const Allocation& allocation)
+	{
+		// Coherent persistent mappings are visible to the GPU without any further calls
+		if ((persistent && allocation.buffer == stream_buffer_id) || allocation.data == nullptr)
+			return;
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	unsigned int stream_buffer::GetBuffer()
+	{
+		return stream_buffer_id;
+	}
+
+	bool stream_buffer::IsPersistent()
+	{
+		return persistent;
+	}
+}
@@ -0,0 +1,63 @@
+/**********************************************************************************************
+*
+*   palmx - internal stream buffer header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+#ifndef PALMX_STREAM_BUFFER_H
+#define PALMX_STREAM_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace palmx::stream_buffer
+{
+	// Write-only memory inside the stream buffer, valid until Commit is called
+	struct Allocation
+	{
+		void* data{ nullptr };
+		unsigned int buffer{ 0 }; // Not always the ring buffer, data that overflows a frame is placed in a buffer of its own
+		size_t offset{ 0 }; // Byte offset of the data inside the buffer
+	};
+
+	// Uses a persistently mapped buffer if buffer storage is available, else falls back to orphaning
+	extern void Init();
+	// Wait until the GPU is done with the part of the ring used by this frame
+	extern void BeginFrame();
+	// Fence all data streamed in the frame
+	extern void EndFrame();
+
+	// Reserve space for this frame's data, the offset is a multiple of the alignment
+	// The ring grows at the next BeginFrame if the frame's segment was exhausted. Data is nullptr if mapping failed.
+	extern Allocation Allocate(size_t size, size_t alignment);
+	// Make the written data visible to the GPU, has to be called before the data is used by a draw
+	extern void Commit(const Allocation& allocation);
+
+	// Changes when the ring grows
+	extern unsigned int GetBuffer();
+	extern bool IsPersistent();
+}
+
+#endif // PALMX_STREAM_BUFFER_H
@@ -0,0 +1,183 @@
+/**********************************************************************************************
+*
+*   palmx - structure of arrays transform store with cached world matrices
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+namespace palmx
+{
+	enum : uint8_t
+	{
+		transform_flag_alive = 1 << 0,
+		transform_flag_dirty = 1 << 1
+	};
+
+	// Every component lives in its own array, so the update pass streams through tightly packed data
+	static std::vector<glm::vec3> transform_positions;
+	static std::vector<glm::vec3> transform_rotations; // Euler Angles
+	static std::vector<glm::vec3> transform_scales;
+	static std::vector<glm::mat4> transform_world_matrices;
+	static std::vector<uint8_t> transform_flags;
+
+	static std::vector<TransformId> dirty_transforms;
+	static std::vector<TransformId> free_transforms;
+
+	static bool IsTransformAlive(TransformId id)
+	{
+		return id < transform_flags.size() && (transform_flags[id] & transform_flag_alive);
+	}
+
+	static void MarkTransformDirty(TransformId id)
+	{
+		PALMX_ASSERT(IsTransformAlive(id), "Invalid transform id");
+
+		if (!(transform_flags[id] & transform_flag_dirty))
+		{
+			transform_flags[id] |= transform_flag_dirty;
+			dirty_transforms.push_back(id);
+		}
+	}
+
+	static void ComputeWorldMatrix(TransformId id)
+	{
+		glm::mat4 matrix = glm::toMat4(glm::quat(glm::radians(transform_rotations[id])));
+		matrix[0] *= transform_scales[id].x;
+		matrix[1] *= transform_scales[id].y;
+		matrix[2] *= transform_scales[id].z;
+		matrix[3] = glm::vec4(transform_positions[id], 1.0f);
+
+		transform_world_matrices[id] = matrix;
+		transform_flags[id] &= ~transform_flag_dirty;
+	}
+
+	TransformId CreateTransform(const Transform& transform)
+	{
+		TransformId id;
+		if (!free_transforms.empty())
+		{
+			id = free_transforms.back();
+			free_transforms.pop_back();
+		}
+		else
+		{
+			id = static_cast<TransformId>(transform_flags.size());
+			transform_positions.emplace_back();
+			transform_rotations.emplace_back();
+			transform_scales.emplace_back();
+			transform_world_matrices.emplace_back();
+			transform_flags.emplace_back();
+		}
+
+		transform_positions[id] = transform.position;
+		transform_rotations[id] = transform.rotation;
+		transform_scales[id] = transform.scale;
+		transform_flags[id] = transform_flag_alive;
+
+		ComputeWorldMatrix(id);
+		return id;
+	}
+
+	void DestroyTransform(TransformId id)
+	{
+		PALMX_ASSERT(IsTransformAlive(id), "Invalid transform id");
+
+		// A pending entry in the dirty list is skipped because the transform is no longer alive
+		transform_flags[id] = 0;
+		free_transforms.push_back(id);
+	}
+
+	void SetTransform(TransformId id, const Transform& transform)
+	{
+		MarkTransformDirty(id);
+
+		transform_positions[id] = transform.position;
+		transform_rotations[id] = transform.rotation;
+		transform_scales[id] = transform.scale;
+	}
+
+	void SetTransformPosition(TransformId id, glm::vec3 position)
+	{
+		MarkTransformDirty(id);
+		transform_positions[id] = position;
+	}
+
+	void SetTransformRotation(TransformId id, glm::vec3 rotation)
+	{
+		MarkTransformDirty(id);
+		transform_rotations[id] = rotation;
+	}
+
+	void SetTransformScale(TransformId id, glm::vec3 scale)
+	{
+		MarkTransformDirty(id);
+		transform_scales[id] = scale;
+	}
+
+	Transform GetTransform(TransformId id)
+	{
+		PALMX_ASSERT(IsTransformAlive(id), "Invalid transform id");
+
+		return { transform_positions[id], transform_rotations[id], transform_scales[id] };
+	}
+
+	void UpdateTransforms()
+	{
+		PALMX_PROFILE_SCOPE("UpdateTransforms");
+
+		// Sorting keeps the pass walking the arrays front to back
+		std::sort(dirty_transforms.begin(), dirty_transforms.end());
+
+		for (TransformId id : dirty_transforms)
+		{
+			// Destroyed or already updated through GetWorldMatrix
+			if (transform_flags[id] != (transform_flag_alive | transform_flag_dirty))
+				continue;
+
+			ComputeWorldMatrix(id);
+		}
+
+		dirty_transforms.clear();
+	}
+
+	const glm::mat4& GetWorldMatrix(TransformId id)
+	{
+		PALMX_ASSERT(IsTransformAlive(id), "Invalid transform id");
+
+		// Transforms changed after the last batched update are recomputed on demand
+		if (transform_flags[id] & transform_flag_dirty)
+		{
+			ComputeWorldMatrix(id);
+		}
+
+		return transform_world_matrices[id];
+	}
+}
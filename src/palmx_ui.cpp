@@ -30,12 +30,17 @@
 #include <glad/glad.h>
 
 #include "palmx_core.h"
+#include "palmx_render_queue.h"
+#include "palmx_render_thread.h"
+#include "palmx_stream_buffer.h"
 #include "palmx_ui.h"
+#include "palmx_vfs.h"
 #include "palmx_default_font.h"
 
 #include <glm/glm.hpp>
 #include <glm/trigonometric.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <ft2build.h>
@@ -44,35 +49,62 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 #include <map>
 
 namespace palmx
 {
 	Font font;
 	Shader font_shader;
+	Shader sprite_shader;
 
-	GLuint text_vao, text_vbo;
+	using render_queue::BatchVertex;
 
-	Shader sprite_shader;
-	GLuint sprite_vao, sprite_vbo, sprite_ebo;
+	GLuint batch_vao;
+	static GLuint batch_vao_buffer{ 0 }; // Buffer the vertex attributes of batch_vao currently source
+
+	// Vertices of the batch currently being accumulated
+	static std::vector<BatchVertex> batch_vertices;
+	static unsigned int batch_program{ 0 };
+	static unsigned int batch_texture{ 0 };
+
+	// Expects batch_vao to be bound
+	static void PointBatchAttributes(GLuint buffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, tex_coords));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, color));
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		batch_vao_buffer = buffer;
+	}
 
 	void ui::Init()
 	{
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		std::string text_vertex_shader = R"(
+		std::string batch_vertex_shader = R"(
             #version 330 core
             
-            layout (location = 0) in vec4 a_Vertex; // <vec2 pos, vec2 tex>
+            layout (location = 0) in vec2 a_Position;
+            layout (location = 1) in vec2 a_TexCoord;
+            layout (location = 2) in vec4 a_Color;
             
 			out vec2 v_TexCoord;
+			out vec4 v_Color;
 
             uniform mat4 u_Projection;
 
             void main()
             {
-                gl_Position = u_Projection * vec4(a_Vertex.xy, 0.0, 1.0);
-                v_TexCoord = a_Vertex.zw;
+                gl_Position = u_Projection * vec4(a_Position, 0.0, 1.0);
+                v_TexCoord = a_TexCoord;
+                v_Color = a_Color;
             }
         )";
 
@@ -80,97 +112,51 @@ namespace palmx
             #version 330 core
 
             in vec2 v_TexCoord;
+            in vec4 v_Color;
 
             out vec4 o_FragColor;
 
-            uniform sampler2D u_Text;
-            uniform vec4 u_Color;
+            uniform sampler2D u_Texture;
 
             void main()
             {    
-                o_FragColor = u_Color * vec4(1.0, 1.0, 1.0, texture(u_Text, v_TexCoord).r);
+                o_FragColor = v_Color * vec4(1.0, 1.0, 1.0, texture(u_Texture, v_TexCoord).r);
             }
         )";
 
-		font_shader = LoadShaderFromMemory(text_vertex_shader, text_fragment_shader);
+		font_shader = LoadShaderFromMemory(batch_vertex_shader, text_fragment_shader);
 		font = LoadDefaultFont();
 
-		glGenVertexArrays(1, &text_vao);
-		glGenBuffers(1, &text_vbo);
-
-		glBindVertexArray(text_vao);
-
-		glBindBuffer(GL_ARRAY_BUFFER, text_vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-
-		std::string sprite_vertex_shader = R"(
-            #version 330 core
-            
-            layout (location = 0) in vec3 a_Position;
-
-            out vec2 v_TexCoord;
-
-            uniform mat4 u_Model;
-            uniform mat4 u_Projection;
-
-            void main()
-            {
-                gl_Position = u_Projection * u_Model * vec4(a_Position, 1.0);
-                v_TexCoord = (a_Position.xy + vec2(1.0, 1.0)) / 2.0;
-            }
-        )";
+		glUseProgram(font_shader.id);
+		glUniform1i(font_shader.locations[shader_location::Texture], 0);
 
 		std::string sprite_fragment_shader = R"(
             #version 330 core
 
             in vec2 v_TexCoord;
+            in vec4 v_Color;
 
             out vec4 o_FragColor;
 
-            uniform vec4 u_Color;
             uniform sampler2D u_Texture;
 
             void main() {
-                o_FragColor = u_Color * texture(u_Texture, v_TexCoord);
+                o_FragColor = v_Color * texture(u_Texture, v_TexCoord);
             }
         )";
 
-		sprite_shader = LoadShaderFromMemory(sprite_vertex_shader, sprite_fragment_shader);
-
-		float sprite_vertices[] = {
-			// positions
-			1.0f,  1.0f, 0.0f,   // top right
-			1.0f, -1.0f, 0.0f,   // bottom right
-			-1.0f, -1.0f, 0.0f,   // bottom left
-			-1.0f,  1.0f, 0.0f    // top left
-		};
-
-		unsigned int sprite_indices[] = {
-			0, 1, 3,   // first triangle
-			1, 2, 3    // second triangle
-		};
-
-		glGenVertexArrays(1, &sprite_vao);
-		glGenBuffers(1, &sprite_vbo);
-		glGenBuffers(1, &sprite_ebo);
+		sprite_shader = LoadShaderFromMemory(batch_vertex_shader, sprite_fragment_shader);
 
-		glBindVertexArray(sprite_vao);
+		glUseProgram(sprite_shader.id);
+		glUniform1i(sprite_shader.locations[shader_location::Texture], 0);
 
-		glBindBuffer(GL_ARRAY_BUFFER, sprite_vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(sprite_vertices), sprite_vertices, GL_STATIC_DRAW);
+		glGenVertexArrays(1, &batch_vao);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sprite_ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(sprite_indices), sprite_indices, GL_STATIC_DRAW);
+		glBindVertexArray(batch_vao);
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(0);
+		// Batches are streamed, draws select their vertices through the first vertex index
+		PointBatchAttributes(stream_buffer::GetBuffer());
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindVertexArray(0);
 	}
 
@@ -179,29 +165,34 @@ namespace palmx
 		glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(width), 0.0f, static_cast<float>(height));
 
 		glUseProgram(font_shader.id);
-		glUniformMatrix4fv(glGetUniformLocation(font_shader.id, "u_Projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		glUniformMatrix4fv(font_shader.locations[shader_location::Projection], 1, GL_FALSE, glm::value_ptr(projection));
 
 		glUseProgram(sprite_shader.id);
-		glUniformMatrix4fv(glGetUniformLocation(sprite_shader.id, "u_Projection"), 1, GL_FALSE, glm::value_ptr(projection));
+		glUniformMatrix4fv(sprite_shader.locations[shader_location::Projection], 1, GL_FALSE, glm::value_ptr(projection));
 	}
 
 	Font LoadFontFromMemory(const unsigned char* font_data, unsigned int font_size)
 	{
+		PALMX_PROFILE_SCOPE("LoadFont");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		std::map<char, Character> characters;
+		if (!render_thread::IsContextThread())
+			return render_thread::Invoke([&]() { return LoadFontFromMemory(font_data, font_size); });
+
+		Font loaded_font = {};
 
 		if (font_data == nullptr || font_size == 0)
 		{
 			PALMX_ERROR("Failed to load font from memory: Invalid data");
-			return { characters };
+			return loaded_font;
 		}
 
 		FT_Library ft;
 		if (FT_Init_FreeType(&ft))
 		{
 			PALMX_ERROR("Could not init FreeType Library");
-			return { characters };
+			return loaded_font;
 		}
 
 		FT_Face face;
@@ -209,17 +200,24 @@ namespace palmx
 		{
 			PALMX_ERROR("Failed to load font from memory");
 			FT_Done_FreeType(ft);
-			return { characters };
+			return loaded_font;
 		}
 		else
 		{
 			FT_Set_Pixel_Sizes(face, 0, 48);
 
-			// Disable byte-alignment restriction
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			// Glyphs are placed in rows from left to right, a new row starts when the current one is full.
+			// One pixel of padding keeps linear filtering from bleeding into neighbouring glyphs.
+			const int atlas_width = 1024;
+			const int padding = 1;
+
+			std::vector<std::vector<unsigned char>> bitmaps(font_glyph_count);
+			std::vector<glm::ivec2> offsets(font_glyph_count);
+			glm::ivec2 cursor(padding, padding);
+			int row_height = 0;
 
 			// Load first 128 characters of ASCII set
-			for (unsigned char c = 0; c < 128; c++)
+			for (unsigned int c = 0; c < font_glyph_count; c++)
 			{
 				// Load character glyph
 				if (FT_Load_Char(face, c, FT_LOAD_RENDER))
@@ -228,38 +226,67 @@ namespace palmx
 					continue;
 				}
 
-				// Generate texture
-				unsigned int texture_id;
-				glGenTextures(1, &texture_id);
-				glBindTexture(GL_TEXTURE_2D, texture_id);
-				glTexImage2D(
-					GL_TEXTURE_2D,
-					0,
-					GL_RED,
-					face->glyph->bitmap.width,
-					face->glyph->bitmap.rows,
-					0,
-					GL_RED,
-					GL_UNSIGNED_BYTE,
-					face->glyph->bitmap.buffer
-				);
-
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-				// Store character for later use
-				Character character = {
-					{texture_id},
-					glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
+				const FT_Bitmap& bitmap = face->glyph->bitmap;
+				int width = static_cast<int>(bitmap.width);
+				int height = static_cast<int>(bitmap.rows);
+
+				if (cursor.x + width + padding > atlas_width)
+				{
+					cursor = glm::ivec2(padding, cursor.y + row_height + padding);
+					row_height = 0;
+				}
+
+				// Copy the rows, FreeType bitmaps may have a pitch larger than their width
+				bitmaps[c].resize(width * height);
+				for (int y = 0; y < height; y++)
+				{
+					std::memcpy(bitmaps[c].data() + y * width, bitmap.buffer + y * bitmap.pitch, width);
+				}
+
+				offsets[c] = cursor;
+				cursor.x += width + padding;
+				row_height = glm::max(row_height, height);
+
+				// Store character for later use, the UVs are known once the atlas size is final
+				loaded_font.characters[c] = {
+					glm::ivec2(width, height),
 					glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
 					static_cast<unsigned int>(face->glyph->advance.x)
 				};
+			}
 
-				characters.insert(std::pair<char, Character>(c, character));
+			int atlas_height = 1;
+			while (atlas_height < cursor.y + row_height + padding)
+			{
+				atlas_height *= 2;
 			}
 
+			std::vector<unsigned char> atlas(atlas_width * atlas_height, 0);
+			for (unsigned int c = 0; c < font_glyph_count; c++)
+			{
+				Character& character = loaded_font.characters[c];
+				for (int y = 0; y < character.size.y; y++)
+				{
+					std::memcpy(&atlas[(offsets[c].y + y) * atlas_width + offsets[c].x], bitmaps[c].data() + y * character.size.x, character.size.x);
+				}
+
+				character.uv_min = glm::vec2(offsets[c]) / glm::vec2(atlas_width, atlas_height);
+				character.uv_max = glm::vec2(offsets[c] + character.size) / glm::vec2(atlas_width, atlas_height);
+			}
+
+			// Disable byte-alignment restriction
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+			// Generate texture
+			glGenTextures(1, &loaded_font.atlas.id);
+			glBindTexture(GL_TEXTURE_2D, loaded_font.atlas.id);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
 			glBindTexture(GL_TEXTURE_2D, 0);
 		}
 
@@ -267,7 +294,7 @@ namespace palmx
 		FT_Done_Face(face);
 		FT_Done_FreeType(ft);
 
-		return { characters };
+		return loaded_font;
 	}
 
 	Font LoadDefaultFont()
@@ -277,21 +304,12 @@ namespace palmx
 
 	Font LoadFont(const std::string& file_path)
 	{
-		std::vector<unsigned char> font_data;
+		vfs::File file;
 
 		if (!file_path.empty())
 		{
-			// Read font file into memory
-			std::ifstream file(file_path, std::ios::binary);
-			if (file)
-			{
-				file.seekg(0, std::ios::end);
-				font_data.resize(file.tellg());
-				file.seekg(0, std::ios::beg);
-				file.read(reinterpret_cast<char*>(font_data.data()), font_data.size());
-				file.close();
-			}
-			else
+			// The glyphs are baked before returning, so the file only has to live until then
+			if (!vfs::ReadFile(file_path, file))
 			{
 				PALMX_ERROR("Failed to load font file at path: " << file_path);
 				return Font();
@@ -303,7 +321,7 @@ namespace palmx
 			return Font();
 		}
 
-		return LoadFontFromMemory(font_data.data(), font_data.size());
+		return LoadFontFromMemory(file.data, static_cast<unsigned int>(file.size));
 	}
 
 	void SetFont(const Font& new_font)
@@ -311,21 +329,34 @@ namespace palmx
 		font = new_font;
 	}
 
-	void DrawString(const std::string& text, glm::vec2 position, float scale, const Color& color)
+	static uint32_t PackColor(const Color& color)
 	{
+		return glm::packUnorm4x8(glm::vec4(color.r, color.g, color.b, color.a));
+	}
+
+	void DrawString(const std::string& text, glm::vec2 position, float scale, const Color& color, uint8_t layer)
+	{
+		PALMX_PROFILE_SCOPE("DrawString");
+
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		// Activate corresponding render state	
-		glUseProgram(font_shader.id);
-		glUniform4f(glGetUniformLocation(font_shader.id, "u_Color"), color.r, color.g, color.b, color.a);
-		glActiveTexture(GL_TEXTURE0);
-		glBindVertexArray(text_vao);
+		render_queue::Command command = {};
+		command.type = render_queue::CommandType::Text;
+		command.textures[0] = font.atlas.id;
+		// Glyph quads go into the per-frame storage of the list, the command references their range
+		render_queue::DrawList& list = render_queue::GetDrawList();
+		command.data_index = static_cast<uint32_t>(list.text_vertices.size());
+
+		uint32_t packed_color = PackColor(color);
 
-		// Iterate through all characters
-		std::string::const_iterator c;
-		for (c = text.begin(); c != text.end(); c++)
+		// The quads are built with the current font, so SetFont can change fonts between strings
+		for (char c : text)
 		{
-			Character ch = font.characters[*c];
+			unsigned char code = static_cast<unsigned char>(c);
+			if (code >= font_glyph_count)
+				continue;
+
+			const Character& ch = font.characters[code];
 
 			float xpos = position.x + ch.bearing.x * scale;
 			float ypos = position.y - (ch.size.y - ch.bearing.y) * scale;
@@ -333,58 +364,210 @@ namespace palmx
 			float w = ch.size.x * scale;
 			float h = ch.size.y * scale;
 
-			// Update VBO for each character
-			float vertices[6][4] = {
-				{ xpos,     ypos + h,   0.0f, 0.0f },
-				{ xpos,     ypos,       0.0f, 1.0f },
-				{ xpos + w, ypos,       1.0f, 1.0f },
-
-				{ xpos,     ypos + h,   0.0f, 0.0f },
-				{ xpos + w, ypos,       1.0f, 1.0f },
-				{ xpos + w, ypos + h,   1.0f, 0.0f }
-			};
+			list.text_vertices.insert(list.text_vertices.end(), {
+				{ { xpos,     ypos + h }, { ch.uv_min.x, ch.uv_min.y }, packed_color },
+				{ { xpos,     ypos     }, { ch.uv_min.x, ch.uv_max.y }, packed_color },
+				{ { xpos + w, ypos     }, { ch.uv_max.x, ch.uv_max.y }, packed_color },
 
-			// Render glyph texture over quad
-			glBindTexture(GL_TEXTURE_2D, ch.texture.id);
-
-			// Update content of VBO memory
-			glBindBuffer(GL_ARRAY_BUFFER, text_vbo);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			// Render Quad
-			glDrawArrays(GL_TRIANGLES, 0, 6);
+				{ { xpos,     ypos + h }, { ch.uv_min.x, ch.uv_min.y }, packed_color },
+				{ { xpos + w, ypos     }, { ch.uv_max.x, ch.uv_max.y }, packed_color },
+				{ { xpos + w, ypos + h }, { ch.uv_max.x, ch.uv_min.y }, packed_color }
+			});
 
 			// Advance cursors for next glyph (note that advance is number of 1/64 pixels)
 			position.x += (ch.advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
 		}
 
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		command.element_count = static_cast<unsigned int>(list.text_vertices.size()) - command.data_index;
+		if (command.element_count == 0)
+			return;
+
+		render_queue::Push(render_queue::MakeUiKey(layer), command);
+	}
+
+	void ui::QueueSprite(const Sprite& sprite, const glm::mat4& transform)
+	{
+		render_queue::Command command = {};
+		command.type = render_queue::CommandType::Sprite;
+		command.textures[0] = sprite.texture.id;
+		command.element_count = 6;
+		command.transform = transform;
+		command.color = sprite.color;
+		command.uv_rect = glm::vec4(sprite.uv_min, sprite.uv_max);
+
+		render_queue::Push(render_queue::MakeUiKey(sprite.layer), command);
 	}
 
 	void DrawSprite(const Sprite& sprite)
+	{
+		PALMX_PROFILE_SCOPE("DrawSprite");
+
+		PALMX_ASSERT(px_data.init, "palmx not initialized");
+
+		ui::QueueSprite(sprite, sprite.transform.GetTransform());
+	}
+
+	SpriteAtlas LoadSpriteAtlas(const std::string& file_path)
 	{
 		PALMX_ASSERT(px_data.init, "palmx not initialized");
 
-		// Only works when face culling is disabled or else the sprite will be invisible
-		glDisable(GL_CULL_FACE);
+		vfs::File atlas_file;
+		if (!vfs::ReadFile(file_path, atlas_file))
+		{
+			PALMX_ERROR("Failed to load sprite atlas at path: " << file_path);
+			return SpriteAtlas();
+		}
 
-		glUseProgram(sprite_shader.id);
+		std::istringstream file(std::string(reinterpret_cast<const char*>(atlas_file.data), atlas_file.size));
 
-		glUniformMatrix4fv(glGetUniformLocation(sprite_shader.id, "u_Model"), 1, GL_FALSE, glm::value_ptr(sprite.transform.GetTransform()));
-		glUniform4f(glGetUniformLocation(sprite_shader.id, "u_Color"), sprite.color.r, sprite.color.g, sprite.color.b, sprite.color.a);
+		// Page images are stored next to the lookup table
+		std::string directory = file_path.substr(0, file_path.find_last_of('/') + 1);
 
-		glActiveTexture(GL_TEXTURE0);
-		glUniform1i(glGetUniformLocation(sprite_shader.id, "u_Texture"), 0);
-		glBindTexture(GL_TEXTURE_2D, sprite.texture.id);
+		SpriteAtlas atlas;
+		std::vector<glm::vec2> page_sizes;
 
-		glBindVertexArray(sprite_vao);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sprite_ebo);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string type;
+			stream >> type;
 
-		// Enable face culling again
-		glEnable(GL_CULL_FACE);
+			if (type == "page")
+			{
+				std::string page_file;
+				glm::vec2 size;
+				stream >> page_file >> size.x >> size.y;
+
+				atlas.pages.push_back(LoadTexture(directory + page_file));
+				page_sizes.push_back(size);
+			}
+			else if (type == "sprite")
+			{
+				std::string name;
+				SpriteRegion region;
+				glm::ivec2 position;
+				stream >> name >> region.page >> position.x >> position.y >> region.size.x >> region.size.y;
+
+				if (stream.fail() || region.page >= page_sizes.size())
+				{
+					PALMX_ERROR("Invalid sprite entry in atlas " << file_path << ": " << line);
+					continue;
+				}
+
+				region.uv_min = glm::vec2(position) / page_sizes[region.page];
+				region.uv_max = glm::vec2(position + region.size) / page_sizes[region.page];
+				atlas.regions[name] = region;
+			}
+		}
+
+		return atlas;
+	}
+
+	Sprite GetAtlasSprite(const SpriteAtlas& atlas, const std::string& name)
+	{
+		Sprite sprite = {};
+
+		auto it = atlas.regions.find(name);
+		if (it == atlas.regions.end())
+		{
+			PALMX_ERROR("Sprite atlas has no region named " << name);
+			return sprite;
+		}
+
+		sprite.texture = atlas.pages[it->second.page];
+		sprite.uv_min = it->second.uv_min;
+		sprite.uv_max = it->second.uv_max;
+		return sprite;
+	}
+
+	void ui::FlushBatch()
+	{
+		PALMX_PROFILE_SCOPE("FlushBatch");
+
+		if (batch_vertices.empty())
+			return;
+
+		// Aligned to the vertex size so the batch can be addressed by its first vertex
+		size_t size = batch_vertices.size() * sizeof(BatchVertex);
+		stream_buffer::Allocation allocation = stream_buffer::Allocate(size, sizeof(BatchVertex));
+		if (allocation.data == nullptr)
+		{
+			PALMX_ERROR("Failed to map the stream buffer for a batch of " << batch_vertices.size() << " vertices");
+			batch_vertices.clear();
+			return;
+		}
+
+		std::memcpy(allocation.data, batch_vertices.data(), size);
+		stream_buffer::Commit(allocation);
+
+		render_queue::UseProgram(batch_program);
+		// Only works when face culling is disabled or else mirrored sprites will be invisible
+		render_queue::SetFaceCulling(false);
+		render_queue::BindVertexArray(batch_vao);
+		render_queue::BindTexture(0, batch_texture);
+
+		// The ring may have grown or the batch may have overflowed into a buffer of its own
+		if (allocation.buffer != batch_vao_buffer)
+			PointBatchAttributes(allocation.buffer);
+
+		glDrawArrays(GL_TRIANGLES, static_cast<GLint>(allocation.offset / sizeof(BatchVertex)), static_cast<GLsizei>(batch_vertices.size()));
+		render_queue::CountDrawCall();
+
+		batch_vertices.clear();
+	}
+
+	// Start a new batch whenever the render state would change
+	static void AddToBatch(unsigned int program, unsigned int texture, const BatchVertex* vertices, size_t count)
+	{
+		if (program != batch_program || texture != batch_texture)
+		{
+			ui::FlushBatch();
+			batch_program = program;
+			batch_texture = texture;
+		}
+
+		batch_vertices.insert(batch_vertices.end(), vertices, vertices + count);
+	}
+
+	static void ExecuteTextCommand(const render_queue::Command& command)
+	{
+		AddToBatch(font_shader.id, command.textures[0], &render_queue::GetSubmittedList().text_vertices[command.data_index], command.element_count);
+	}
+
+	static void ExecuteSpriteCommand(const render_queue::Command& command)
+	{
+		// Sprites are quads spanning -1 to 1, the texture coordinates follow the position inside the sprite's region
+		const glm::vec2 corners[4] = { { 1.0f, 1.0f }, { 1.0f, -1.0f }, { -1.0f, -1.0f }, { -1.0f, 1.0f } };
+
+		uint32_t packed_color = PackColor(command.color);
+		glm::vec2 uv_min(command.uv_rect.x, command.uv_rect.y);
+		glm::vec2 uv_max(command.uv_rect.z, command.uv_rect.w);
+
+		BatchVertex quad[4];
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec4 position = command.transform * glm::vec4(corners[i].x, corners[i].y, 0.0f, 1.0f);
+			glm::vec2 uv = uv_min + (uv_max - uv_min) * ((corners[i] + glm::vec2(1.0f, 1.0f)) * 0.5f);
+			quad[i] = { glm::vec2(position.x, position.y), uv, packed_color };
+		}
+
+		const BatchVertex vertices[6] = { quad[0], quad[1], quad[3], quad[1], quad[2], quad[3] };
+		AddToBatch(sprite_shader.id, command.textures[0], vertices, 6);
+	}
+
+	void ui::ExecuteCommand(const render_queue::Command& command)
+	{
+		switch (command.type)
+		{
+		case render_queue::CommandType::Text:
+			ExecuteTextCommand(command);
+			break;
+		case render_queue::CommandType::Sprite:
+			ExecuteSpriteCommand(command);
+			break;
+		default:
+			break;
+		}
 	}
-}
\ No newline at end of file
+}
@@ -29,12 +29,18 @@
 #ifndef PALMX_UI_H
 #define PALMX_UI_H
 
+#include "palmx_render_queue.h"
+
 #include <cstdint>
 
 namespace palmx::ui
 {
 	extern void Init();
 	extern void OnWindowResize(uint32_t width, uint32_t height);
+	// Sprite and text commands are accumulated into batches, a batch is drawn when the program or texture changes
+	extern void ExecuteCommand(const render_queue::Command& command);
+	extern void FlushBatch();
+	extern void QueueSprite(const Sprite& sprite, const glm::mat4& transform);
 }
 
 #endif // PALMX_UI_H
\ No newline at end of file
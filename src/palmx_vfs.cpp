@@ -0,0 +1,246 @@
+/**********************************************************************************************
+*
+*   palmx - virtual filesystem over pack files and loose files
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#include "pxpch.h"
+#include "palmx_vfs.h"
+#include "palmx_asset_formats.h"
+#include "palmx_lz.h"
+
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+
+namespace palmx
+{
+	struct Pack
+	{
+		std::string file_path;
+		std::string mount_point; // Normalized, ends with a slash
+		std::shared_ptr<MappedFile> file;
+		std::vector<asset_format::PackEntry> entries; // Sorted by path hash
+	};
+
+	// Mounting happens on the main thread, loaders on worker threads only read
+	static std::shared_mutex packs_mutex;
+	static std::vector<Pack> packs;
+
+	static std::string NormalizePath(const std::string& file_path)
+	{
+		return std::filesystem::path(file_path).lexically_normal().generic_string();
+	}
+
+	// Path inside the pack, or false if the path is not below the pack's mount point
+	static bool GetPackPath(const Pack& pack, const std::string& normalized_path, std::string_view& pack_path)
+	{
+		if (normalized_path.compare(0, pack.mount_point.size(), pack.mount_point) != 0)
+			return false;
+
+		pack_path = std::string_view(normalized_path).substr(pack.mount_point.size());
+		return true;
+	}
+
+	static const asset_format::PackEntry* FindEntry(const Pack& pack, std::string_view pack_path)
+	{
+		uint64_t hash = asset_format::HashPath(pack_path);
+
+		auto it = std::lower_bound(pack.entries.begin(), pack.entries.end(), hash,
+			[](const asset_format::PackEntry& entry, uint64_t hash) { return entry.path_hash < hash; });
+
+		for (; it != pack.entries.end() && it->path_hash == hash; ++it)
+		{
+			std::string_view entry_path(reinterpret_cast<const char*>(pack.file->GetData() + it->path_offset), it->path_length);
+			if (entry_path == pack_path)
+				return &*it;
+		}
+
+		return nullptr;
+	}
+
+	// Newest mount first, so later packs can patch earlier ones
+	static const asset_format::PackEntry* FindPackedFile(const std::string& file_path, const Pack*& found_pack)
+	{
+		std::string normalized_path = NormalizePath(file_path);
+
+		for (auto pack = packs.rbegin(); pack != packs.rend(); ++pack)
+		{
+			std::string_view pack_path;
+			if (!GetPackPath(*pack, normalized_path, pack_path))
+				continue;
+
+			const asset_format::PackEntry* entry = FindEntry(*pack, pack_path);
+			if (entry != nullptr)
+			{
+				found_pack = &*pack;
+				return entry;
+			}
+		}
+
+		return nullptr;
+	}
+
+	bool vfs::ReadFile(const std::string& file_path, File& file)
+	{
+		PALMX_PROFILE_SCOPE("ReadFile");
+
+		file = File();
+
+		{
+			std::shared_lock<std::shared_mutex> lock(packs_mutex);
+
+			const Pack* pack = nullptr;
+			const asset_format::PackEntry* entry = FindPackedFile(file_path, pack);
+			if (entry != nullptr)
+			{
+				const uint8_t* stored = pack->file->GetData() + entry->offset;
+
+				if (entry->compression == asset_format::pack_compression::None)
+				{
+					file.mapping = pack->file;
+					file.data = stored;
+					file.size = entry->size;
+					return true;
+				}
+
+				file.buffer.resize(entry->size);
+				if (!lz::Decompress(stored, entry->stored_size, file.buffer.data(), file.buffer.size()))
+				{
+					PALMX_ERROR("Corrupt entry " << file_path << " in pack " << pack->file_path);
+					file = File();
+					return false;
+				}
+
+				file.data = file.buffer.data();
+				file.size = file.buffer.size();
+				return true;
+			}
+		}
+
+		std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+		if (!mapping->Open(file_path))
+			return false;
+
+		file.mapping = mapping;
+		file.data = mapping->GetData();
+		file.size = mapping->GetSize();
+		return true;
+	}
+
+	bool vfs::Exists(const std::string& file_path)
+	{
+		if (IsPacked(file_path))
+			return true;
+
+		std::error_code error;
+		return std::filesystem::is_regular_file(file_path, error);
+	}
+
+	bool vfs::IsPacked(const std::string& file_path)
+	{
+		std::shared_lock<std::shared_mutex> lock(packs_mutex);
+
+		const Pack* pack = nullptr;
+		return FindPackedFile(file_path, pack) != nullptr;
+	}
+
+	bool MountPack(const std::string& file_path, const std::string& mount_point)
+	{
+		PALMX_PROFILE_SCOPE("MountPack");
+
+		Pack pack;
+		pack.file_path = file_path;
+		pack.file = std::make_shared<MappedFile>();
+		if (!pack.file->Open(file_path))
+		{
+			PALMX_ERROR("Failed to open pack at path: " << file_path);
+			return false;
+		}
+
+		const uint8_t* data = pack.file->GetData();
+		size_t size = pack.file->GetSize();
+
+		asset_format::PackHeader header;
+		if (size < sizeof(header))
+		{
+			PALMX_ERROR("Pack is truncated: " << file_path);
+			return false;
+		}
+
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, asset_format::pack_magic, sizeof(header.magic)) != 0 || header.version != asset_format::pack_version)
+		{
+			PALMX_ERROR("Pack has an unknown format or version: " << file_path);
+			return false;
+		}
+
+		if (header.index_offset > size || static_cast<uint64_t>(header.entry_count) * sizeof(asset_format::PackEntry) > size - header.index_offset)
+		{
+			PALMX_ERROR("Pack is truncated: " << file_path);
+			return false;
+		}
+
+		pack.entries.resize(header.entry_count);
+		std::memcpy(pack.entries.data(), data + header.index_offset, pack.entries.size() * sizeof(asset_format::PackEntry));
+
+		// Validate every entry once, so lookups can trust the index
+		for (const asset_format::PackEntry& entry : pack.entries)
+		{
+			bool valid = entry.offset <= size && entry.stored_size <= size - entry.offset
+				&& entry.path_offset <= size && entry.path_length <= size - entry.path_offset
+				&& (entry.compression == asset_format::pack_compression::Lz || (entry.compression == asset_format::pack_compression::None && entry.stored_size == entry.size));
+			if (!valid)
+			{
+				PALMX_ERROR("Pack has a corrupt index: " << file_path);
+				return false;
+			}
+		}
+
+		std::string root = NormalizePath(mount_point.empty() ? GetResourceDir() : mount_point);
+		if (!root.empty() && root.back() != '/')
+			root += '/';
+		// Relative paths are looked up as they are when the pack is mounted at "."
+		if (root == "./")
+			root.clear();
+		pack.mount_point = root;
+
+		std::unique_lock<std::shared_mutex> lock(packs_mutex);
+		packs.push_back(std::move(pack));
+
+		PALMX_INFO("Mounted pack " << file_path << " with " << header.entry_count << " files");
+		return true;
+	}
+
+	void UnmountPack(const std::string& file_path)
+	{
+		std::unique_lock<std::shared_mutex> lock(packs_mutex);
+
+		// Files that were read from the pack keep the mapping alive until they are released
+		std::erase_if(packs, [&file_path](const Pack& pack) { return pack.file_path == file_path; });
+	}
+}
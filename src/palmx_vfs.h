@@ -0,0 +1,62 @@
+/**********************************************************************************************
+*
+*   palmx - internal virtual filesystem header
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+**********************************************************************************************/
+
+
+#ifndef PALMX_VFS_H
+#define PALMX_VFS_H
+
+#include "palmx_mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Every loader reads through here. Mounted packs are searched first (the last mounted one
+// wins), then the path is memory mapped as a loose file.
+namespace palmx::vfs
+{
+	// Contents of a file. Uncompressed data points straight into the mapping, which the file keeps alive.
+	struct File
+	{
+		const uint8_t* data{ nullptr };
+		size_t size{ 0 };
+
+		std::shared_ptr<MappedFile> mapping;
+		std::vector<uint8_t> buffer; // Holds decompressed pack entries
+	};
+
+	// Safe to call from worker threads
+	extern bool ReadFile(const std::string& file_path, File& file);
+	extern bool Exists(const std::string& file_path);
+	// Files served by a pack have no timestamp
+	extern bool IsPacked(const std::string& file_path);
+}
+
+#endif // PALMX_VFS_H
@@ -45,5 +45,6 @@
 
 #include <palmx.h>
 #include <palmx_debug.h>
+#include <palmx_profile.h>
 
 #endif // PXPCH_H
\ No newline at end of file
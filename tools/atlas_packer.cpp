@@ -0,0 +1,414 @@
+/*******************************************************************************************
+*
+*   palmx tool - sprite atlas packer
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+********************************************************************************************/
+
+
+// Packs all images of a directory into atlas pages and writes a lookup table for LoadSpriteAtlas.
+//
+// Usage: palmx_atlas_packer <image directory> <output path without extension> [page size] [padding]
+//
+// Output:
+//   <output>_<page>.png   One RGBA image per atlas page
+//   <output>.atlas        Lookup table, one entry per line:
+//                         page <file name> <width> <height>
+//                         sprite <name> <page> <x> <y> <width> <height>
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Image
+{
+	std::string name;
+	int width{ 0 };
+	int height{ 0 };
+	std::vector<uint8_t> pixels; // RGBA8
+
+	// Placement inside the atlas
+	int page{ -1 };
+	int x{ 0 };
+	int y{ 0 };
+};
+
+// Skyline bottom-left packer, the skyline stores the top edge of everything placed so far
+struct SkylineNode
+{
+	int x;
+	int y;
+	int width;
+};
+
+struct Page
+{
+	std::vector<SkylineNode> skyline;
+};
+
+// Lowest y at which a rectangle of the given width fits when its left edge is at the node, -1 if it does not fit
+static int FitSkyline(const Page& page, size_t node_index, int width, int height, int page_size)
+{
+	int x = page.skyline[node_index].x;
+	if (x + width > page_size)
+		return -1;
+
+	int y = 0;
+	int remaining_width = width;
+	for (size_t i = node_index; remaining_width > 0; i++)
+	{
+		if (i == page.skyline.size())
+			return -1;
+
+		y = std::max(y, page.skyline[i].y);
+		if (y + height > page_size)
+			return -1;
+
+		remaining_width -= page.skyline[i].width;
+	}
+
+	return y;
+}
+
+static bool InsertSkyline(Page& page, int width, int height, int page_size, int& out_x, int& out_y)
+{
+	int best_y = page_size;
+	int best_width = page_size;
+	size_t best_index = page.skyline.size();
+
+	for (size_t i = 0; i < page.skyline.size(); i++)
+	{
+		int y = FitSkyline(page, i, width, height, page_size);
+		if (y < 0)
+			continue;
+
+		// Prefer the lowest position, break ties with the narrowest node to reduce wasted space
+		if (y < best_y || (y == best_y && page.skyline[i].width < best_width))
+		{
+			best_y = y;
+			best_width = page.skyline[i].width;
+			best_index = i;
+		}
+	}
+
+	if (best_index == page.skyline.size())
+		return false;
+
+	out_x = page.skyline[best_index].x;
+	out_y = best_y;
+
+	// Insert the new top edge and shrink or remove the nodes it covers
+	SkylineNode node = { out_x, out_y + height, width };
+	page.skyline.insert(page.skyline.begin() + best_index, node);
+
+	for (size_t i = best_index + 1; i < page.skyline.size();)
+	{
+		SkylineNode& previous = page.skyline[i - 1];
+		SkylineNode& current = page.skyline[i];
+
+		int previous_end = previous.x + previous.width;
+		if (current.x >= previous_end)
+			break;
+
+		int shrink = previous_end - current.x;
+		current.x += shrink;
+		current.width -= shrink;
+
+		if (current.width <= 0)
+		{
+			page.skyline.erase(page.skyline.begin() + i);
+			continue;
+		}
+
+		break;
+	}
+
+	// Merge neighbours at the same height
+	for (size_t i = 0; i + 1 < page.skyline.size();)
+	{
+		if (page.skyline[i].y == page.skyline[i + 1].y)
+		{
+			page.skyline[i].width += page.skyline[i + 1].width;
+			page.skyline.erase(page.skyline.begin() + i + 1);
+			continue;
+		}
+
+		i++;
+	}
+
+	return true;
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+	static std::array<uint32_t, 256> table = [] {
+		std::array<uint32_t, 256> result = {};
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+			}
+			result[i] = value;
+		}
+		return result;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+static void WriteBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static void WriteChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	WriteBigEndian(chunk, static_cast<uint32_t>(data.size()));
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	WriteBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+// Writes an uncompressed PNG (stored deflate blocks), the atlas is only an intermediate build artifact
+static bool WritePng(const std::string& path, int width, int height, const std::vector<uint8_t>& pixels)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<uint8_t> header;
+	WriteBigEndian(header, width);
+	WriteBigEndian(header, height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, no interlacing
+	WriteChunk(file, "IHDR", header);
+
+	// Every row starts with filter type 0 (none)
+	std::vector<uint8_t> raw;
+	raw.reserve((width * 4 + 1) * height);
+	for (int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), pixels.begin() + y * width * 4, pixels.begin() + (y + 1) * width * 4);
+	}
+
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < raw.size() || offset == 0;)
+	{
+		size_t block_size = std::min<size_t>(raw.size() - offset, 65535);
+		bool last = offset + block_size == raw.size();
+
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(block_size));
+		zlib.push_back(static_cast<uint8_t>(block_size >> 8));
+		zlib.push_back(static_cast<uint8_t>(~block_size));
+		zlib.push_back(static_cast<uint8_t>(~block_size >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + block_size);
+
+		offset += block_size;
+		if (last)
+			break;
+	}
+
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	WriteBigEndian(zlib, (b << 16) | a);
+
+	WriteChunk(file, "IDAT", zlib);
+	WriteChunk(file, "IEND", {});
+
+	return file.good();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <image directory> <output path without extension> [page size] [padding]" << std::endl;
+		return 1;
+	}
+
+	fs::path input_directory = argv[1];
+	fs::path output_path = argv[2];
+	int page_size = argc > 3 ? std::stoi(argv[3]) : 1024;
+	int padding = argc > 4 ? std::stoi(argv[4]) : 1;
+
+	std::vector<Image> images;
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input_directory))
+	{
+		if (!entry.is_regular_file())
+			continue;
+
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".tga" && extension != ".bmp")
+			continue;
+
+		Image image;
+		int components;
+		uint8_t* data = stbi_load(entry.path().string().c_str(), &image.width, &image.height, &components, 4);
+		if (data == nullptr)
+		{
+			std::cerr << "Failed to load image " << entry.path() << ": " << stbi_failure_reason() << std::endl;
+			return 1;
+		}
+
+		if (image.width + padding * 2 > page_size || image.height + padding * 2 > page_size)
+		{
+			std::cerr << "Image " << entry.path() << " does not fit into a " << page_size << "x" << page_size << " page" << std::endl;
+			stbi_image_free(data);
+			return 1;
+		}
+
+		// Sprites are looked up by their path relative to the input directory, without extension
+		fs::path name = fs::relative(entry.path(), input_directory);
+		name.replace_extension();
+		image.name = name.generic_string();
+		if (image.name.find_first_of(" \t") != std::string::npos)
+		{
+			std::cerr << "Image " << entry.path() << " contains whitespace in its name" << std::endl;
+			stbi_image_free(data);
+			return 1;
+		}
+
+		image.pixels.assign(data, data + image.width * image.height * 4);
+		stbi_image_free(data);
+
+		images.push_back(std::move(image));
+	}
+
+	if (images.empty())
+	{
+		std::cerr << "No images found in " << input_directory << std::endl;
+		return 1;
+	}
+
+	// Placing tall images first leaves a flatter skyline, ties are broken by name to keep the output stable
+	std::vector<Image*> order;
+	for (Image& image : images)
+	{
+		order.push_back(&image);
+	}
+
+	std::sort(order.begin(), order.end(), [](const Image* a, const Image* b) {
+		if (a->height != b->height)
+			return a->height > b->height;
+		if (a->width != b->width)
+			return a->width > b->width;
+		return a->name < b->name;
+	});
+
+	std::vector<Page> pages;
+	for (Image* image : order)
+	{
+		int width = image->width + padding * 2;
+		int height = image->height + padding * 2;
+
+		for (size_t page_index = 0; image->page < 0; page_index++)
+		{
+			if (page_index == pages.size())
+			{
+				pages.push_back({ { { 0, 0, page_size } } });
+			}
+
+			int x, y;
+			if (InsertSkyline(pages[page_index], width, height, page_size, x, y))
+			{
+				image->page = static_cast<int>(page_index);
+				image->x = x + padding;
+				image->y = y + padding;
+			}
+		}
+	}
+
+	std::ofstream table(output_path.string() + ".atlas");
+	if (!table)
+	{
+		std::cerr << "Failed to write " << output_path.string() << ".atlas" << std::endl;
+		return 1;
+	}
+
+	for (size_t page_index = 0; page_index < pages.size(); page_index++)
+	{
+		std::vector<uint8_t> pixels(page_size * page_size * 4, 0);
+		for (const Image& image : images)
+		{
+			if (image.page != static_cast<int>(page_index))
+				continue;
+
+			for (int y = 0; y < image.height; y++)
+			{
+				std::copy_n(image.pixels.begin() + y * image.width * 4, image.width * 4, pixels.begin() + ((image.y + y) * page_size + image.x) * 4);
+			}
+		}
+
+		std::string page_file = output_path.filename().string() + "_" + std::to_string(page_index) + ".png";
+		fs::path page_path = output_path.parent_path() / page_file;
+		if (!WritePng(page_path.string(), page_size, page_size, pixels))
+		{
+			std::cerr << "Failed to write " << page_path << std::endl;
+			return 1;
+		}
+
+		table << "page " << page_file << " " << page_size << " " << page_size << "\n";
+	}
+
+	std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.name < b.name; });
+	for (const Image& image : images)
+	{
+		table << "sprite " << image.name << " " << image.page << " " << image.x << " " << image.y << " " << image.width << " " << image.height << "\n";
+	}
+
+	std::cout << "Packed " << images.size() << " images into " << pages.size() << " page(s)" << std::endl;
+	return 0;
+}
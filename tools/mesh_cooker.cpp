@@ -0,0 +1,97 @@
+/*******************************************************************************************
+*
+*   palmx tool - mesh cooker
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+********************************************************************************************/
+
+
+
+// Runs the Assimp import pipeline once and writes a .pxmesh file whose vertex and index data
+// is already in GPU layout, so shipping builds can load models without Assimp.
+//
+// Usage: palmx_mesh_cooker <model> [output path] [standard|static|compact]
+//
+// Without an output path the .pxmesh file is written next to the model. LoadModel picks it up
+// automatically when it is not older than the model.
+
+#include "palmx_model_import.h"
+#include "palmx_job_system.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <model> [output path] [standard|static|compact]" << std::endl;
+		return 1;
+	}
+
+	fs::path input_path = argv[1];
+	fs::path output_path = argc > 2 ? fs::path(argv[2]) : fs::path(input_path).replace_extension(".pxmesh");
+	std::string format_name = argc > 3 ? argv[3] : "standard";
+
+	palmx::VertexFormat format;
+	if (format_name == "standard")
+		format = palmx::vertex_format::Standard;
+	else if (format_name == "static")
+		format = palmx::vertex_format::Static;
+	else if (format_name == "compact")
+		format = palmx::vertex_format::Compact;
+	else
+	{
+		std::cerr << "Unknown vertex format " << format_name << ", expected standard, static or compact" << std::endl;
+		return 1;
+	}
+
+	// Meshes are converted in parallel
+	palmx::job_system::Init();
+
+	std::vector<palmx::model_import::MeshData> meshes;
+	bool imported = palmx::model_import::ImportModel(input_path.string(), format, meshes);
+
+	palmx::job_system::Shutdown();
+
+	if (!imported)
+		return 1;
+
+	if (output_path.has_parent_path())
+		fs::create_directories(output_path.parent_path());
+
+	if (!palmx::model_import::WriteCookedModel(output_path.string(), meshes))
+		return 1;
+
+	size_t vertex_count = 0;
+	for (const palmx::model_import::MeshData& mesh : meshes)
+		vertex_count += mesh.info.vertex_count;
+
+	std::cout << input_path.string() << " -> " << output_path.string() << " (" << meshes.size() << " meshes, " << vertex_count << " vertices, " << format_name << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*******************************************************************************************
+*
+*   palmx tool - pack file builder
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+********************************************************************************************/
+
+
+
+// Packs a directory into a single .pxpack file for MountPack.
+//
+// Usage: palmx_packer <directory> <output.pxpack> [--store]
+//
+// Paths inside the pack are relative to the directory. Every file is LZ compressed unless that
+// saves less than an eighth of its size (e.g. PNGs), or --store is given. Cooked .pxtex and
+// .pxmesh files are packed like any other file, so cook before packing.
+
+#include "palmx_asset_formats.h"
+#include "palmx_lz.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <directory> <output.pxpack> [--store]" << std::endl;
+		return 1;
+	}
+
+	fs::path input_directory = argv[1];
+	fs::path output_path = argv[2];
+	bool store = argc > 3 && std::string(argv[3]) == "--store";
+
+	std::vector<fs::path> files;
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input_directory))
+	{
+		if (entry.is_regular_file() && fs::absolute(entry.path()) != fs::absolute(output_path))
+			files.push_back(entry.path());
+	}
+
+	// Deterministic output regardless of directory iteration order
+	std::sort(files.begin(), files.end());
+
+	std::ofstream output(output_path, std::ios::binary);
+	if (!output)
+	{
+		std::cerr << "Failed to open " << output_path << " for writing" << std::endl;
+		return 1;
+	}
+
+	palmx::asset_format::PackHeader header = {};
+	std::memcpy(header.magic, palmx::asset_format::pack_magic, sizeof(header.magic));
+	header.version = palmx::asset_format::pack_version;
+	header.entry_count = static_cast<uint32_t>(files.size());
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<palmx::asset_format::PackEntry> entries;
+	uint64_t total_size = 0;
+	uint64_t total_stored_size = 0;
+
+	for (const fs::path& file_path : files)
+	{
+		std::ifstream file(file_path, std::ios::binary);
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (!file.good() && !file.eof())
+		{
+			std::cerr << "Failed to read " << file_path << std::endl;
+			return 1;
+		}
+
+		std::string pack_path = fs::relative(file_path, input_directory).generic_string();
+
+		palmx::asset_format::PackEntry entry = {};
+		entry.path_hash = palmx::asset_format::HashPath(pack_path);
+		entry.size = data.size();
+
+		std::vector<uint8_t> compressed;
+		if (!store)
+			palmx::lz::Compress(data.data(), data.size(), compressed);
+
+		const std::vector<uint8_t>* stored = &data;
+		entry.compression = palmx::asset_format::pack_compression::None;
+		if (!store && compressed.size() < data.size() - data.size() / 8)
+		{
+			stored = &compressed;
+			entry.compression = palmx::asset_format::pack_compression::Lz;
+		}
+
+		// Align data to 16 bytes, uncompressed entries are read in place from the mapping
+		static const char zeros[16] = {};
+		uint64_t position = static_cast<uint64_t>(output.tellp());
+		output.write(zeros, (16 - position % 16) % 16);
+
+		entry.offset = static_cast<uint64_t>(output.tellp());
+		entry.stored_size = stored->size();
+		output.write(reinterpret_cast<const char*>(stored->data()), stored->size());
+
+		entry.path_offset = static_cast<uint64_t>(output.tellp());
+		entry.path_length = static_cast<uint32_t>(pack_path.size());
+		output.write(pack_path.data(), pack_path.size());
+
+		entries.push_back(entry);
+		total_size += entry.size;
+		total_stored_size += entry.stored_size;
+	}
+
+	std::stable_sort(entries.begin(), entries.end(),
+		[](const palmx::asset_format::PackEntry& a, const palmx::asset_format::PackEntry& b) { return a.path_hash < b.path_hash; });
+
+	static const char zeros[8] = {};
+	uint64_t position = static_cast<uint64_t>(output.tellp());
+	output.write(zeros, (8 - position % 8) % 8);
+
+	header.index_offset = static_cast<uint64_t>(output.tellp());
+	output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(palmx::asset_format::PackEntry));
+
+	output.seekp(0);
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if (!output)
+	{
+		std::cerr << "Failed to write " << output_path << std::endl;
+		return 1;
+	}
+
+	std::cout << "Packed " << entries.size() << " files, " << total_size << " -> " << total_stored_size << " bytes" << std::endl;
+	return 0;
+}
@@ -0,0 +1,209 @@
+/*******************************************************************************************
+*
+*   palmx tool - texture cooker
+*
+*	MIT License
+*
+*   Copyright (c) 2023 Maximilian Fischer (getmyisland)
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy
+*   of this software and associated documentation files (the "Software"), to deal
+*   in the Software without restriction, including without limitation the rights
+*   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*   copies of the Software, and to permit persons to whom the Software is
+*   furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in all
+*   copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*   SOFTWARE.
+*
+********************************************************************************************/
+
+
+
+// Decodes images once and writes them as .pxtex files with a full mip chain, so the runtime
+// can upload them straight from a memory mapped file.
+//
+// Usage: palmx_texture_cooker <image or directory> [output directory]
+//
+// Every image is written next to its source (or into the output directory) with the
+// extension replaced by .pxtex. LoadTexture picks the cooked file up automatically.
+
+#include "palmx_asset_formats.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Level
+{
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> pixels;
+};
+
+// Box filter each 2x2 block, odd edges reuse the last row or column
+static Level Downsample(const Level& source, int components)
+{
+	Level level;
+	level.width = std::max(source.width / 2, 1u);
+	level.height = std::max(source.height / 2, 1u);
+	level.pixels.resize(static_cast<size_t>(level.width) * level.height * components);
+
+	for (uint32_t y = 0; y < level.height; y++)
+	{
+		uint32_t y0 = std::min(y * 2, source.height - 1);
+		uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+
+		for (uint32_t x = 0; x < level.width; x++)
+		{
+			uint32_t x0 = std::min(x * 2, source.width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+
+			for (int c = 0; c < components; c++)
+			{
+				uint32_t sum = source.pixels[(static_cast<size_t>(y0) * source.width + x0) * components + c]
+					+ source.pixels[(static_cast<size_t>(y0) * source.width + x1) * components + c]
+					+ source.pixels[(static_cast<size_t>(y1) * source.width + x0) * components + c]
+					+ source.pixels[(static_cast<size_t>(y1) * source.width + x1) * components + c];
+
+				level.pixels[(static_cast<size_t>(y) * level.width + x) * components + c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+
+	return level;
+}
+
+static bool CookTexture(const fs::path& input_path, const fs::path& output_path)
+{
+	int width, height, components;
+	uint8_t* data = stbi_load(input_path.string().c_str(), &width, &height, &components, 0);
+	if (data == nullptr)
+	{
+		std::cerr << "Failed to load image " << input_path << ": " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+
+	// The runtime has no two component format, expand it like the other loaders would
+	if (components == 2)
+	{
+		stbi_image_free(data);
+		data = stbi_load(input_path.string().c_str(), &width, &height, &components, 4);
+		components = 4;
+	}
+
+	std::vector<Level> levels(1);
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(data, data + static_cast<size_t>(width) * height * components);
+	stbi_image_free(data);
+
+	while (levels.back().width > 1 || levels.back().height > 1)
+		levels.push_back(Downsample(levels.back(), components));
+
+	palmx::asset_format::TextureHeader header = {};
+	std::memcpy(header.magic, palmx::asset_format::texture_magic, sizeof(header.magic));
+	header.version = palmx::asset_format::texture_version;
+	header.width = width;
+	header.height = height;
+	header.components = components;
+	header.level_count = static_cast<uint32_t>(levels.size());
+
+	std::vector<palmx::asset_format::TextureLevel> level_table(levels.size());
+	uint64_t offset = sizeof(header) + level_table.size() * sizeof(palmx::asset_format::TextureLevel);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		level_table[i].offset = offset;
+		level_table[i].size = levels[i].pixels.size();
+		level_table[i].width = levels[i].width;
+		level_table[i].height = levels[i].height;
+		offset += levels[i].pixels.size();
+	}
+
+	std::ofstream file(output_path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Failed to open " << output_path << " for writing" << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(level_table.data()), level_table.size() * sizeof(palmx::asset_format::TextureLevel));
+	for (const Level& level : levels)
+		file.write(reinterpret_cast<const char*>(level.pixels.data()), level.pixels.size());
+
+	std::cout << input_path.string() << " -> " << output_path.string() << " (" << width << "x" << height << ", " << levels.size() << " levels)" << std::endl;
+	return true;
+}
+
+static bool IsImage(const fs::path& path)
+{
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <image or directory> [output directory]" << std::endl;
+		return 1;
+	}
+
+	fs::path input_path = argv[1];
+	fs::path output_directory = argc > 2 ? fs::path(argv[2]) : fs::path();
+
+	std::vector<fs::path> images;
+	fs::path input_root = input_path;
+	if (fs::is_directory(input_path))
+	{
+		for (const fs::directory_entry& entry : fs::recursive_directory_iterator(input_path))
+		{
+			if (entry.is_regular_file() && IsImage(entry.path()))
+				images.push_back(entry.path());
+		}
+	}
+	else
+	{
+		images.push_back(input_path);
+		input_root = input_path.parent_path();
+	}
+
+	if (images.empty())
+	{
+		std::cerr << "No images found in " << input_path << std::endl;
+		return 1;
+	}
+
+	for (const fs::path& image : images)
+	{
+		// Keep the directory structure below the input when writing somewhere else
+		fs::path output_path = output_directory.empty() ? image : output_directory / fs::relative(image, input_root);
+		output_path.replace_extension(".pxtex");
+		if (output_path.has_parent_path())
+			fs::create_directories(output_path.parent_path());
+
+		if (!CookTexture(image, output_path))
+			return 1;
+	}
+
+	return 0;
+}